@@ -8,11 +8,18 @@
 %code requires {
 	#include "compiler/Parser.h"
 	using namespace s22;
+
+	// Allow the parser stacks to be relocated when nesting gets deep
+	static_assert(std::is_trivially_copyable_v<s22::YY_Symbol> && std::is_trivially_copyable_v<s22::Source_Location>);
+	#define YYSTYPE_IS_TRIVIAL 1
+	#define YYLTYPE_IS_TRIVIAL 1
+	#define YYMAXDEPTH 100000
 }
 
 %define api.value.type		{ s22::YY_Symbol }			// token data type
 %parse-param				{ s22::Parser *p }			// parser function parameters
 %locations												// generate token location code
+%lex-param					{ s22::Parser *p }			// lexer function parameters, the parser holds the token stream
 %define api.pure full									// modify yylex to receive parameters as shown in %code provides
 %define api.location.type	{ s22::Source_Location }	// source location type, aliased by YYLTYPE
 %define parse.trace										// allow debugging
@@ -20,10 +27,10 @@
 
 // Forward declarations for Lexer
 %code provides {
-	// Lexer entry-point declaration
+	// Lexer entry-point declaration, matches the reentrant flex scanner
 	#define YY_DECL \
 	int \
-	yylex(YYSTYPE * yylval_param, YYLTYPE * yylloc_param)
+	yylex(YYSTYPE * yylval_param, YYLTYPE * yylloc_param, yyscan_t yyscanner)
 
 	YY_DECL;
 
@@ -32,6 +39,64 @@
 	#define YYLOCATION_PRINT location_print
 }
 
+// Token stream
+%code {
+	// The source is lexed up front, hand the parser the next token
+	// Invalid characters and overflowing literals are reported here, names are interned on the parser's thread the first time they are seen
+	inline static int
+	yylex(YYSTYPE *yylval_param, YYLTYPE *yylloc_param, s22::Parser *p)
+	{
+		auto &tokens = p->tokens;
+		while (true)
+		{
+			auto i = p->token_next;
+			auto kind = token_kind_unpack(tokens.kinds[i]);
+			*yylloc_param = { tokens.offsets[i], tokens.lengths[i] };
+
+			// Bison may ask again after the end of input
+			if (kind == 0)
+				return 0;
+
+			p->token_next++;
+			if (kind == TOKEN_INVALID)
+			{
+				yyerror(yylloc_param, p, "unexpected character");
+				continue;
+			}
+
+			// Parsed with its saturated value, the literal's kind is told by its text
+			if (kind == TOKEN_OVERFLOW)
+			{
+				auto text = p->source.substr(tokens.offsets[i], tokens.lengths[i]);
+				if (text.ends_with('u'))
+					kind = LIT_UINT;
+				else if (text.find('.') != std::string_view::npos)
+					kind = LIT_FLOAT;
+				else
+					kind = LIT_INT;
+				parser_log(Error{ *yylloc_param, E_LITERAL_TOO_LARGE });
+			}
+
+			if (kind == IDENTIFIER)
+			{
+				auto &id = p->token_names[tokens.values[i]];
+				if (!id)
+				{
+					auto name = tokens.names[tokens.values[i]];
+					id = str_intern(p->source.substr(name.offset, name.length));
+				}
+				yylval_param->id = id;
+			}
+			else
+			{
+				yylval_param->value.value = tokens.values[i];
+			}
+
+			return kind;
+		}
+	}
+}
+
 // TOKENS
 /// Keywords
 %token <value> CONST WHILE DO FOR SWITCH CASE DEFAULT PROC RETURN
@@ -65,7 +130,7 @@
 %type <unit> decl_var decl_const decl_proc
 
 %printer { semexpr_print($$, yyo); } type
-%printer { fprintf(yyo, "%s", $$.data); } IDENTIFIER
+%printer { fprintf(yyo, "%s", str_view($$).data()); } IDENTIFIER
 
 // OPERATOR PRECEDENCE (LOWEST TO HIGHEST)
 %left L_OR
@@ -360,9 +425,11 @@ yyreport_syntax_error(const yypcontext_t *ctx, s22::Parser *parser)
 
 	if (auto lookahead = yypcontext_token(ctx); lookahead != YYSYMBOL_YYEMPTY)
 	{
-		auto msg = std::format("unexpected {}", yysymbol_name(lookahead));
+		// Symbol names are static, the message is formatted when displayed
+		Error err = { *loc, E_SYNTAX, yysymbol_name(lookahead) };
 
 		constexpr auto TOKEN_MAX = 5;
+		static_assert(TOKEN_MAX + 1 <= Error::ARGS_MAX);
 		yysymbol_kind_t expected[TOKEN_MAX];
 
 		int num_expected = yypcontext_expected_tokens(ctx, expected, TOKEN_MAX);
@@ -377,18 +444,11 @@ yyreport_syntax_error(const yypcontext_t *ctx, s22::Parser *parser)
 
 			for (int i = 0; i < num_expected; i++)
 			{
-				if (i == 0)
-				{
-					msg += std::format(", expected {}", yysymbol_name(expected[i]));
-				}
-				else
-				{
-					msg += std::format(" or {}", yysymbol_name(expected[i]));
-				}
+				err.args[err.arg_count++] = yysymbol_name(expected[i]);
 			}
 
 
-			s22::parser_log(Error{*loc, "{}", msg}, s22::Log_Level::ERROR);
+			s22::parser_log(err, s22::Log_Level::ERROR);
 		}
 	}
 
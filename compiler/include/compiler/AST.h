@@ -1,5 +1,8 @@
 #pragma once
 #include "compiler/Util.h"
+#include "compiler/Semantic_Expr.h"
+
+#include <vector>
 
 namespace s22
 {
@@ -21,11 +24,19 @@ namespace s22
 	struct Block;			// { <STATEMENTS> }
 	struct Return;			// return expr;
 
+	struct AST_Pool;
+
+	// AST pool of the current compilation
+	// Defined in Parser.cpp
+	AST_Pool *
+	ast_pool_instance();
+
 	// Each abstract syntax subtree represents a statement, which can be either one of all the previous expressions
-	// AST is a tagged union of different statement types
+	// AST is a handle to a node stored in the AST pool of the current compilation
+	// The node lives at index idx of the pool array of its kind, symbols are indexed in AST_Pool::symbols
 	struct AST
 	{
-		enum KIND
+		enum KIND : uint32_t
 		{
 			NIL,
 			LITERAL, SYMBOL, PROC_CALL, ARRAY_ACCESS,
@@ -45,28 +56,37 @@ namespace s22
 			RETURN,
 		};
 		KIND kind;
+		uint32_t idx;
+
+		// Node accessors, the pointers are invalidated when another node of the same kind is built
+		// Hot loops pass the pool explicitly to avoid looking it up per node
+		inline Literal *as_lit(AST_Pool *pool = ast_pool_instance()) const;
+		inline Symbol *as_sym(AST_Pool *pool = ast_pool_instance()) const;
+		inline Proc_Call *as_pcall(AST_Pool *pool = ast_pool_instance()) const;
+		inline Array_Access *as_arr_access(AST_Pool *pool = ast_pool_instance()) const;
+		inline Binary_Op *as_binary(AST_Pool *pool = ast_pool_instance()) const;
+		inline Unary_Op *as_unary(AST_Pool *pool = ast_pool_instance()) const;
+		inline Assignment *as_assign(AST_Pool *pool = ast_pool_instance()) const;
+		inline Decl *as_decl(AST_Pool *pool = ast_pool_instance()) const;
+		inline Decl_Proc *as_decl_proc(AST_Pool *pool = ast_pool_instance()) const;
+		inline If_Condition *as_if(AST_Pool *pool = ast_pool_instance()) const;
+		inline Switch *as_switch(AST_Pool *pool = ast_pool_instance()) const;
+		inline Switch_Case *as_case(AST_Pool *pool = ast_pool_instance()) const;
+		inline While_Loop *as_while(AST_Pool *pool = ast_pool_instance()) const;
+		inline Do_While_Loop *as_do_while(AST_Pool *pool = ast_pool_instance()) const;
+		inline For_Loop *as_for(AST_Pool *pool = ast_pool_instance()) const;
+		inline Block *as_block(AST_Pool *pool = ast_pool_instance()) const;
+		inline Return *as_return(AST_Pool *pool = ast_pool_instance()) const;
+	};
+	static_assert(sizeof(AST) == 8);
 
-		union
-		{
-			void *as_nil;
-			Literal *as_lit;
-			Symbol *as_sym;
-			Proc_Call *as_pcall;
-			Array_Access *as_arr_access;
-			Binary_Op *as_binary;
-			Unary_Op *as_unary;
-			Assignment *as_assign;
-			Decl *as_decl;
-			Decl_Proc *as_decl_proc;
-			If_Condition *as_if;
-			Switch *as_switch;
-			Switch_Case *as_case;
-			While_Loop *as_while;
-			Do_While_Loop *as_do_while;
-			For_Loop *as_for;
-			Block *as_block;
-			Return *as_return;
-		};
+	constexpr size_t AST_KIND_COUNT = AST::RETURN + 1;
+
+	// Contiguous range of child nodes in AST_Pool::children
+	struct AST_Range
+	{
+		uint32_t first;
+		uint32_t count;
 	};
 
 	struct Literal
@@ -91,7 +111,7 @@ namespace s22
 
 	// Constructors for different types of ASTs
 	AST
-	ast_literal(Literal *literal);
+	ast_literal(Literal literal);
 
 	AST
 	ast_symbol(Symbol *sym);
@@ -99,11 +119,11 @@ namespace s22
 	struct Proc_Call
 	{
 		Symbol *sym;
-		Buf<AST> args;
+		AST_Range args;
 	};
 
 	AST
-	ast_pcall(Symbol *sym, const Buf<AST> &args);
+	ast_pcall(Symbol *sym, AST_Range args);
 
 	struct Array_Access
 	{
@@ -117,21 +137,23 @@ namespace s22
 	struct Binary_Op
 	{
 		enum KIND {} kind;
+		Semantic_Expr::BASE type;	// of the left operand
 		AST left;
 		AST right;
 	};
 
 	AST
-	ast_binary(Binary_Op::KIND kind, AST left, AST right);
+	ast_binary(Binary_Op::KIND kind, Semantic_Expr::BASE type, AST left, AST right);
 
 	struct Unary_Op
 	{
 		enum KIND {} kind;
+		Semantic_Expr::BASE type;	// of the operand
 		AST right;
 	};
 
 	AST
-	ast_unary(Unary_Op::KIND kind, AST right);
+	ast_unary(Unary_Op::KIND kind, Semantic_Expr::BASE type, AST right);
 
 	struct Assignment
 	{
@@ -155,81 +177,81 @@ namespace s22
 	struct Decl_Proc
 	{
 		Symbol *sym;
-		Buf<Decl *> args;
-		Block *block;
+		AST_Range args;			// DECL nodes
+		AST block;
 	};
 
 	AST
-	ast_decl_proc(Symbol *sym, const Buf<Decl *> &args, Block *block);
+	ast_decl_proc(Symbol *sym, AST_Range args, AST block);
 
 	struct If_Condition
 	{
 		AST cond; 				// NIL for else
-		If_Condition *prev;		// NIL for if
-		If_Condition *next;		// NIL for else
+		AST prev;				// NIL for if
+		AST next;				// NIL for else
 
-		Block *block;
+		AST block;
 	};
 
 	AST
-	ast_if(If_Condition *prev, AST cond, Block *block, If_Condition *next);
+	ast_if(AST prev, AST cond, AST block, AST next);
 
 	struct Switch_Case
 	{
 		AST expr;
-		Buf<Literal*> group;
-		Block *block;
+		AST_Range group;		// LITERAL nodes
+		AST block;
 	};
 
 	AST
-	ast_switch_case(AST expr, const Buf<Literal*> &group, Block *block);
+	ast_switch_case(AST expr, AST_Range group, AST block);
 
 	struct Switch
 	{
-		Buf<Switch_Case*> cases;
-		Block *case_default;
+		AST_Range cases;		// SWITCH_CASE nodes
+		AST case_default;		// NIL if there is no default case
 	};
 
 	AST
-	ast_switch(const Buf<Switch_Case*> &cases, Block *case_default);
+	ast_switch(AST_Range cases, AST case_default);
 
 	struct While_Loop
 	{
 		AST cond;
-		Block *block;
+		AST block;
 	};
 
 	AST
-	ast_while(AST cond, Block *block);
+	ast_while(AST cond, AST block);
 
 	struct Do_While_Loop
 	{
 		AST cond;
-		Block *block;
+		AST block;
 	};
 
 	AST
-	ast_do_while(AST cond, Block *block);
+	ast_do_while(AST cond, AST block);
 
 	struct For_Loop
 	{
 		AST init;
 		AST cond;
 		AST post;
-		Block *block;
+		AST block;
 	};
 
 	AST
-	ast_for(AST init, AST cond, AST post, Block *block);
+	ast_for(AST init, AST cond, AST post, AST block);
 
 	struct Block
 	{
-		Buf<AST> stmts;
+		AST_Range stmts;
 		size_t used_stack_size;
 	};
 
 	AST
-	ast_block(const Buf<AST> &stmts, size_t used_stack_size = 0);
+	ast_block(AST_Range stmts, size_t used_stack_size = 0);
 
 	struct Return
 	{
@@ -239,4 +261,107 @@ namespace s22
 
 	AST
 	ast_return(AST expr, Symbol *sym);
-}
\ No newline at end of file
+
+	// Node store of the current compilation
+	// Nodes of each kind are packed in their own array, child lists are ranges of the shared children array
+	struct AST_Pool
+	{
+		std::vector<Literal> literals;
+		std::vector<Symbol *> symbols;
+		std::vector<Proc_Call> pcalls;
+		std::vector<Array_Access> arr_accesses;
+		std::vector<Binary_Op> binaries;
+		std::vector<Unary_Op> unaries;
+		std::vector<Assignment> assigns;
+		std::vector<Decl> decls;
+		std::vector<Decl_Proc> decl_procs;
+		std::vector<If_Condition> ifs;
+		std::vector<Switch> switches;
+		std::vector<Switch_Case> cases;
+		std::vector<While_Loop> whiles;
+		std::vector<Do_While_Loop> do_whiles;
+		std::vector<For_Loop> fors;
+		std::vector<Block> blocks;
+		std::vector<Return> returns;
+
+		std::vector<AST> children;
+	};
+
+	// Keeps the allocated capacity for the next compilation
+	void
+	ast_pool_clear(AST_Pool *self);
+
+	// Number of nodes of a kind built so far
+	size_t
+	ast_pool_count(const AST_Pool *self, AST::KIND kind);
+
+	// Appends a zeroed range of count children, filled through ast_children
+	AST_Range
+	ast_range_make(size_t count);
+
+	// Appends a copy of the nodes as a single range
+	AST_Range
+	ast_range_clone(const std::vector<AST> &nodes);
+
+	// Children of a range, the view is invalidated when another range is appended
+	inline static Buf<AST>
+	ast_children(AST_Range range, AST_Pool *pool = ast_pool_instance())
+	{
+		Buf<AST> self = { .data = pool->children.data() + range.first, .count = range.count };
+		return self;
+	}
+
+	inline Literal *AST::as_lit(AST_Pool *pool) const				{ return &pool->literals[idx]; }
+	inline Symbol *AST::as_sym(AST_Pool *pool) const					{ return pool->symbols[idx]; }
+	inline Proc_Call *AST::as_pcall(AST_Pool *pool) const			{ return &pool->pcalls[idx]; }
+	inline Array_Access *AST::as_arr_access(AST_Pool *pool) const	{ return &pool->arr_accesses[idx]; }
+	inline Binary_Op *AST::as_binary(AST_Pool *pool) const			{ return &pool->binaries[idx]; }
+	inline Unary_Op *AST::as_unary(AST_Pool *pool) const				{ return &pool->unaries[idx]; }
+	inline Assignment *AST::as_assign(AST_Pool *pool) const			{ return &pool->assigns[idx]; }
+	inline Decl *AST::as_decl(AST_Pool *pool) const					{ return &pool->decls[idx]; }
+	inline Decl_Proc *AST::as_decl_proc(AST_Pool *pool) const		{ return &pool->decl_procs[idx]; }
+	inline If_Condition *AST::as_if(AST_Pool *pool) const			{ return &pool->ifs[idx]; }
+	inline Switch *AST::as_switch(AST_Pool *pool) const				{ return &pool->switches[idx]; }
+	inline Switch_Case *AST::as_case(AST_Pool *pool) const			{ return &pool->cases[idx]; }
+	inline While_Loop *AST::as_while(AST_Pool *pool) const			{ return &pool->whiles[idx]; }
+	inline Do_While_Loop *AST::as_do_while(AST_Pool *pool) const		{ return &pool->do_whiles[idx]; }
+	inline For_Loop *AST::as_for(AST_Pool *pool) const				{ return &pool->fors[idx]; }
+	inline Block *AST::as_block(AST_Pool *pool) const				{ return &pool->blocks[idx]; }
+	inline Return *AST::as_return(AST_Pool *pool) const				{ return &pool->returns[idx]; }
+}
+
+template <>
+struct std::formatter<s22::AST::KIND> : std::formatter<std::string>
+{
+	auto
+	format(s22::AST::KIND kind, format_context &ctx)
+	{
+		const char *str = "UNREACHABLE";
+		switch (kind)
+		{
+		case s22::AST::NIL:				str = "nil"; break;
+		case s22::AST::LITERAL:			str = "literal"; break;
+		case s22::AST::SYMBOL:			str = "symbol"; break;
+		case s22::AST::PROC_CALL:		str = "proc call"; break;
+		case s22::AST::ARRAY_ACCESS:	str = "array access"; break;
+		case s22::AST::BINARY:			str = "binary"; break;
+		case s22::AST::UNARY:			str = "unary"; break;
+		case s22::AST::ASSIGN:			str = "assign"; break;
+		case s22::AST::DECL:			str = "decl"; break;
+		case s22::AST::DECL_PROC:		str = "decl proc"; break;
+		case s22::AST::IF_COND:			str = "if"; break;
+		case s22::AST::SWITCH:			str = "switch"; break;
+		case s22::AST::SWITCH_CASE:		str = "switch case"; break;
+		case s22::AST::WHILE:			str = "while"; break;
+		case s22::AST::DO_WHILE:		str = "do while"; break;
+		case s22::AST::FOR:				str = "for"; break;
+		case s22::AST::BLOCK:			str = "block"; break;
+		case s22::AST::RETURN:			str = "return"; break;
+
+		default:
+			break;
+		}
+
+		return format_to(ctx.out(), "{}", str);
+	}
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include "compiler/Util.h"
+
 #include <vector>
 #include <array>
 #include <string>
@@ -11,7 +13,7 @@ namespace s22
 	using Backend = IBackend*;
 
 	// Instructions are defined in the header to directly map different operation kinds to instructions
-	enum INSTRUCTION_OP
+	enum INSTRUCTION_OP : uint8_t
 	{
 		// Used for labels
 		I_NOP,
@@ -32,14 +34,205 @@ namespace s22
 		// Logical unary
 		I_LOG_NOT,
 
+		// Set dst to 0 or 1, logical ones take operands that already are
+		I_SLT, I_SLE, I_SEQ, I_SNE, I_SGT, I_SGE,
+		I_LAND, I_LOR,
+
 		// Procedures and stack
 		I_PUSH, I_POP,
 		I_CALL, I_RET,
 	};
 
-	// Backend singleton instance
+	struct Label
+	{
+		enum TYPE : uint32_t
+		{
+			NONE,
+
+			LABEL,
+
+			OR_TRUE, END_OR,
+			AND_FALSE, END_AND,
+			NOT_TRUE, END_NOT,
+			COND_FALSE, END_COND,
+
+			END_IF, END_ELSEIF, END_ALL,
+			CASE, END_CASE, END_SWITCH,
+
+			FOR, END_FOR,
+			WHILE, END_WHILE,
+
+			PROC, END_PROC,
+		};
+		TYPE type;
+
+		union
+		{
+			uint32_t id; // used for standard labels
+			Str_Id text; // used for proc labels
+		};
+	};
+
+	// Temporary register
+	// Memory address
+	// Immediate value
+	// Condition
+	enum OPERAND_LOCATION : uint8_t
+	{
+		OP_NIL,				// NIL value
+		OP_TMP,				// intermediate value
+		OP_IMM,				// immediate value
+		OP_SYM,				// symbol
+		OP_LBL,				// label
+		OP_ELEM,			// array element, sym(index)
+		OP_PARAM,			// procedure parameter slot, sym$index
+		OP_RET,				// procedure return slot, t$sym
+	};
+
+	// 16 bytes, no operand owns memory
+	struct Operand
+	{
+		OPERAND_LOCATION loc;
+		OPERAND_LOCATION index_loc;	// location of the index of OP_ELEM, one of OP_TMP, OP_IMM or OP_SYM
+		Str_Id sym;					// symbol for OP_SYM, array for OP_ELEM, procedure for OP_PARAM and OP_RET
+
+		inline Operand() = default;
+		inline Operand(OPERAND_LOCATION l)		{ *this = {}; loc = l; }
+		inline Operand(int v)					{ *this = {}; loc = OP_IMM; value = (uint64_t)v; }
+		inline Operand(uint64_t v)				{ *this = {}; loc = OP_IMM; value = v; }
+		inline Operand(Str_Id s)				{ *this = {}; loc = OP_SYM; sym = s; }
+		inline Operand(Label lbl)				{ *this = {}; loc = OP_LBL; label = lbl; }
+
+		union
+		{
+			uint64_t value;				// immediate value, index of OP_ELEM (value/temp/symbol), slot of OP_PARAM
+			uint64_t tmp_label_suffix;
+			Label label;				// set when loc is a label
+		};
+	};
+	static_assert(sizeof(Operand) == 16);
+
+	// Single quadruple, used while emitting and printing
+	// The program itself is stored in Program
+	struct Instruction
+	{
+		INSTRUCTION_OP op;
+		Operand dst, src1, src2;
+
+		size_t operand_count;
+		Label label;// adds a label to the instruction
+		uint8_t type;// Semantic_Expr::BASE of the operands of arithmetic and compares, VOID if unknown
+	};
+
+	// Structure of arrays program store
+	// Instruction i has opcode ops[i], operands [3i, 3i + 3) and label labels[i]
+	struct Program
+	{
+		struct Opcode
+		{
+			INSTRUCTION_OP op;
+			uint8_t operand_count;
+			uint8_t type;
+		};
+
+		std::vector<Opcode> ops;			// opcode stream
+		std::vector<Operand> operands;		// operand stream, 3 slots per instruction
+		std::vector<Label> labels;			// label table, NONE for unlabeled instructions
+
+		inline size_t count() const { return ops.size(); }
+	};
+
+	inline static void
+	program_push(Program &self, const Instruction &ins)
+	{
+		self.ops.push_back({ ins.op, (uint8_t)ins.operand_count, ins.type });
+		self.operands.push_back(ins.dst);
+		self.operands.push_back(ins.src1);
+		self.operands.push_back(ins.src2);
+		self.labels.push_back(ins.label);
+	}
+
+	inline static Instruction
+	program_get(const Program &self, size_t i)
+	{
+		Instruction ins = {
+			.op = self.ops[i].op,
+			.dst = self.operands[3 * i + 0],
+			.src1 = self.operands[3 * i + 1],
+			.src2 = self.operands[3 * i + 2],
+			.operand_count = self.ops[i].operand_count,
+			.label = self.labels[i],
+			.type = self.ops[i].type,
+		};
+		return ins;
+	}
+
+	inline static void
+	program_clear(Program &self)
+	{
+		self.ops.clear();
+		self.operands.clear();
+		self.labels.clear();
+	}
+
+	// Move the instructions marked in keep to the front in order and drop the rest, returns the number dropped
+	inline static size_t
+	program_compact(Program &self, const std::vector<uint8_t> &keep)
+	{
+		auto count = self.count();
+		size_t kept = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (keep[i] == false)
+				continue;
+
+			self.ops[kept] = self.ops[i];
+			self.labels[kept] = self.labels[i];
+			for (size_t k = 0; k < 3; k++)
+				self.operands[3 * kept + k] = self.operands[3 * i + k];
+			kept++;
+		}
+		self.ops.resize(kept);
+		self.operands.resize(3 * kept);
+		self.labels.resize(kept);
+
+		return count - kept;
+	}
+
+	// Key identifying a label, standard and procedure labels share the id bits
+	inline static uint64_t
+	label_key(Label label)
+	{
+		return (uint64_t)label.type << 32 | label.id;
+	}
+
+	// Branches end their block, all of them but BR may fall through
+	inline static bool
+	op_is_branch(INSTRUCTION_OP op)
+	{
+		switch (op)
+		{
+		case I_BR:
+		case I_BZ:
+		case I_BNZ:
+		case I_LOG_LT:
+		case I_LOG_LEQ:
+		case I_LOG_EQ:
+		case I_LOG_NEQ:
+		case I_LOG_GT:
+		case I_LOG_GEQ:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Create a backend, each compilation owns one
 	Backend
-	backend_instance();
+	backend_new();
+
+	void
+	backend_free(Backend self);
 
 	// Cleanup resources
 	void
@@ -49,8 +242,182 @@ namespace s22
 	void
 	backend_compile(Backend self, AST ast);
 
+	// Optimize the compiled program in place through SSA form, returns the number of quadruples removed
+	size_t
+	backend_optimize(Backend self);
+
+	// Remove the branches and labels the program does not need, returns the number of quadruples removed
+	// Runs after backend_optimize, which leaves branches to the next instruction behind
+	size_t
+	backend_peephole(Backend self);
+
+	// Append the program as text, one quadruple per line
+	void
+	backend_write(Backend self, std::string &out);
+
+	// Number of quadruples of the compiled program, labels included
+	size_t
+	backend_instruction_count(Backend self);
+
+	// Program of the last compilation, valid until the backend is disposed
+	const Program &
+	backend_program(Backend self);
+
 	// Output quadruples (label (1) + instruction (4))
 	using UI_Program = std::vector<std::array<std::string, 5>>;
 	UI_Program
 	backend_get_ui_program(Backend self);
-}
\ No newline at end of file
+}
+
+template <>
+struct std::formatter<s22::Label> : std::formatter<std::string>
+{
+	auto
+	format(s22::Label label, format_context &ctx)
+	{
+		using namespace s22;
+
+		const char *lbl = nullptr;
+		switch (label.type)
+		{
+		case Label::LABEL: 		lbl = "LABEL"; 		break;
+
+		case Label::OR_TRUE: 	lbl = "OR_TRUE"; 	break;
+		case Label::END_OR: 	lbl = "END_OR"; 	break;
+
+		case Label::AND_FALSE: 	lbl = "AND_FALSE"; 	break;
+		case Label::END_AND: 	lbl = "END_AND"; 	break;
+
+		case Label::NOT_TRUE: 	lbl = "NOT_TRUE"; 	break;
+		case Label::END_NOT: 	lbl = "END_NOT"; 	break;
+
+		case Label::COND_FALSE: lbl = "COND_FALSE"; break;
+		case Label::END_COND: 	lbl = "END_COND"; 	break;
+
+		case Label::END_IF: 	lbl = "END_IF";		break;
+		case Label::END_ELSEIF: lbl = "END_ELSEIF";	break;
+		case Label::END_ALL: 	lbl = "END_ALL";	break;
+
+		case Label::CASE: 		lbl = "CASE";		break;
+		case Label::END_CASE: 	lbl = "END_CASE";	break;
+		case Label::END_SWITCH: lbl = "END_SWITCH";	break;
+
+		case Label::FOR: 		lbl = "FOR";		break;
+		case Label::END_FOR: 	lbl = "END_FOR";	break;
+
+		case Label::WHILE: 		lbl = "WHILE";		break;
+		case Label::END_WHILE: 	lbl = "END_WHILE";	break;
+
+		case Label::PROC:		return format_to(ctx.out(), "{}", label.text);
+		case Label::END_PROC:	return format_to(ctx.out(), "{}$end", label.text);
+
+		default: return ctx.out();
+		}
+		return format_to(ctx.out(), "{}${}", lbl, label.id);
+	}
+};
+
+template <>
+struct std::formatter<s22::Operand> : std::formatter<std::string>
+{
+	auto
+	format(s22::Operand opr, format_context &ctx)
+	{
+		using namespace s22;
+		switch (opr.loc)
+		{
+		case OP_NIL: return ctx.out();
+		case OP_TMP: return format_to(ctx.out(), "t{}", opr.tmp_label_suffix);
+		case OP_IMM: return format_to(ctx.out(), "{}", opr.value);
+		case OP_SYM: return format_to(ctx.out(), "{}", opr.sym);
+		case OP_LBL: return format_to(ctx.out(), "{}", opr.label);
+		case OP_PARAM: return format_to(ctx.out(), "{}${}", opr.sym, opr.value);
+		case OP_RET: return format_to(ctx.out(), "t${}", opr.sym);
+		case OP_ELEM: {
+			switch (opr.index_loc)
+			{
+			case OP_TMP: return format_to(ctx.out(), "t{}({})", opr.value, opr.sym);
+			case OP_SYM: return format_to(ctx.out(), "{}({})", Str_Id{(uint32_t)opr.value}, opr.sym);
+			default: return format_to(ctx.out(), "{}({})", opr.value, opr.sym);
+			}
+		}
+		default: return ctx.out();
+		}
+	}
+};
+
+template <>
+struct std::formatter<s22::INSTRUCTION_OP> : std::formatter<std::string>
+{
+	auto
+	format(s22::INSTRUCTION_OP op, format_context &ctx)
+	{
+		using namespace s22;
+		switch (op)
+		{
+		case I_NOP: return ctx.out();
+		case I_MOV: return format_to(ctx.out(), "=");
+
+		// Arithmetic
+		case I_ADD: return format_to(ctx.out(), "+");
+		case I_SUB: return format_to(ctx.out(), "-");
+		case I_MUL: return format_to(ctx.out(), "*");
+		case I_DIV: return format_to(ctx.out(), "/");
+		case I_MOD: return format_to(ctx.out(), "%");
+		case I_AND: return format_to(ctx.out(), "&");
+		case I_OR:	return format_to(ctx.out(), "|");
+		case I_XOR: return format_to(ctx.out(), "^");
+		case I_SHL: return format_to(ctx.out(), "<<");
+		case I_SHR: return format_to(ctx.out(), ">>");
+		case I_NEG: return format_to(ctx.out(), "neg");
+		case I_INV: return format_to(ctx.out(), "~");
+
+		// Logical
+		case I_LOG_LT:	return format_to(ctx.out(), "BLT");
+		case I_LOG_LEQ: return format_to(ctx.out(), "BLE");
+		case I_LOG_EQ:	return format_to(ctx.out(), "BEQ");
+		case I_LOG_NEQ: return format_to(ctx.out(), "BNE");
+		case I_LOG_GEQ: return format_to(ctx.out(), "BGE");
+		case I_LOG_GT:	return format_to(ctx.out(), "BGT");
+
+		// Set
+		case I_SLT:  return format_to(ctx.out(), "SLT");
+		case I_SLE:  return format_to(ctx.out(), "SLE");
+		case I_SEQ:  return format_to(ctx.out(), "SEQ");
+		case I_SNE:  return format_to(ctx.out(), "SNE");
+		case I_SGT:  return format_to(ctx.out(), "SGT");
+		case I_SGE:  return format_to(ctx.out(), "SGE");
+		case I_LAND: return format_to(ctx.out(), "LAND");
+		case I_LOR:  return format_to(ctx.out(), "LOR");
+
+		// Branch
+		case I_BR:	return format_to(ctx.out(), "BR");
+		case I_BZ:	return format_to(ctx.out(), "BZ");
+		case I_BNZ: return format_to(ctx.out(), "BNZ");
+
+		// Procedures
+		case I_CALL: return format_to(ctx.out(), "CALL");
+		case I_RET:  return format_to(ctx.out(), "RET");
+
+		default: return ctx.out();
+		}
+	}
+};
+
+template <>
+struct std::formatter<s22::Instruction> : std::formatter<std::string>
+{
+	auto
+	format(s22::Instruction ins, format_context &ctx)
+	{
+		if (ins.label.type != s22::Label::NONE)
+			format_to(ctx.out(), "{}: ", ins.label);
+
+		format_to(ctx.out(), "{}", ins.op);
+		if (ins.operand_count >= 1) format_to(ctx.out(), " {}", ins.dst);
+		if (ins.operand_count >= 2) format_to(ctx.out(), ", {}", ins.src1);
+		if (ins.operand_count == 3) format_to(ctx.out(), ", {}", ins.src2);
+
+		return ctx.out();
+	}
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include "compiler/Backend.h"
+
+#include <vector>
+
+namespace s22
+{
+	constexpr uint32_t CFG_NONE = UINT32_MAX;
+
+	// Open addressing table from labels to the instructions they label
+	struct Label_Index
+	{
+		struct Slot
+		{
+			uint64_t key;	// 0 for empty slots, labels are never NONE
+			uint32_t ins;
+		};
+		std::vector<Slot> slots;	// power of 2 size
+	};
+
+	inline static size_t
+	label_slot(uint64_t key, size_t cap)
+	{
+		return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (cap - 1);
+	}
+
+	// Index the labels of program, the first of procedures sharing a name wins, previous entries are discarded
+	void
+	label_index_build(Label_Index &self, const Program &program);
+
+	// Instruction labeled with label, CFG_NONE if it is not defined
+	inline static uint32_t
+	label_index_find(const Label_Index &self, Label label)
+	{
+		auto key = label_key(label);
+		for (auto s = label_slot(key, self.slots.size());; s = (s + 1) & (self.slots.size() - 1))
+		{
+			auto &slot = self.slots[s];
+			if (slot.key == key)
+				return slot.ins;
+			if (slot.key == 0)
+				return CFG_NONE;
+		}
+	}
+
+	// Basic block, instructions [begin, end) of the program
+	// Control enters at begin and leaves after the last instruction, which is the only branch of the block
+	struct CFG_Block
+	{
+		uint32_t begin, end;
+		uint32_t succs[2];				// branch target, then the next block, CFG_NONE when missing
+		uint32_t preds, pred_count;		// predecessors are CFG::preds[preds, preds + pred_count)
+		uint32_t idom;					// immediate dominator, CFG_NONE for the entry and unreachable blocks
+		uint32_t dom_begin, dom_end;	// preorder interval of the block's subtree in the dominator tree, empty if unreachable
+		uint32_t loop;					// innermost loop containing the block, CFG_NONE outside loops
+	};
+
+	// Natural loop, the blocks dominated by header that reach one of its back edges
+	struct CFG_Loop
+	{
+		uint32_t header;
+		uint32_t parent;	// enclosing loop, CFG_NONE for outermost loops
+		uint32_t depth;		// 1 for outermost loops
+	};
+
+	// Control flow graph of a procedure, calls fall through to the next instruction
+	struct CFG
+	{
+		Str_Id proc;					// empty for the code outside procedures
+		std::vector<CFG_Block> blocks;	// in program order, blocks[0] is the entry
+		std::vector<uint32_t> preds;
+		std::vector<uint32_t> order;	// reachable blocks in reverse postorder
+		std::vector<CFG_Loop> loops;	// inner loops come before the loops enclosing them
+	};
+
+	// Control flow graphs of a program, one per procedure
+	// Procedures are emitted inline, the code around a procedure flows from right before it to right after it
+	struct Program_CFG
+	{
+		std::vector<CFG> procs;			// procs[0] is the code outside procedures
+		std::vector<uint32_t> targets;	// instruction labeled with the target of each branch or call, CFG_NONE for the rest
+	};
+
+	// Build the control flow graphs of program in time linear in its size, previous graphs are discarded
+	void
+	cfg_build(Program_CFG &self, const Program &program);
+
+	// Append the blocks of every graph as text, with their edges, dominators and loops
+	void
+	cfg_write(const Program_CFG &self, const Program &program, std::string &out);
+
+	// Whether every path from the entry to block b goes through block a
+	inline static bool
+	cfg_dominates(const CFG &self, uint32_t a, uint32_t b)
+	{
+		auto &x = self.blocks[a], &y = self.blocks[b];
+		return y.dom_begin < y.dom_end && x.dom_begin <= y.dom_begin && y.dom_begin < x.dom_end;
+	}
+}
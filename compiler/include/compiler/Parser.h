@@ -2,50 +2,318 @@
 
 #include "compiler/AST.h"
 #include "compiler/Backend.h"
+#include "compiler/Pool.h"
 #include "compiler/Semantic_Expr.h"
+#include "compiler/Source.h"
 #include "compiler/Symbol.h"
 
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <limits>
 #include <stack>
 #include <unordered_set>
 
 typedef struct yy_buffer_state *YY_BUFFER_STATE;
+typedef void *yyscan_t;
 
 namespace s22
 {
+	// Kind of a character no rule matches, reported when the parser consumes it
+	constexpr int TOKEN_INVALID = -1;
+
+	// Kind of a numeric literal too large for its type, reported when the parser consumes it
+	constexpr int TOKEN_OVERFLOW = -2;
+
+	// Token kinds are stored in a byte, characters are ASCII and Bison's named tokens start at 256
+	// The negative kinds take the top of the byte
+	inline static uint8_t
+	token_kind_pack(int kind)
+	{
+		if (kind < 0)
+			return (uint8_t)(0x100 + kind);
+		return kind < 256 ? (uint8_t)kind : (uint8_t)(kind - 128);
+	}
+
+	inline static int
+	token_kind_unpack(uint8_t kind)
+	{
+		if (kind >= 0x100 + TOKEN_OVERFLOW)
+			return kind - 0x100;
+		return kind < 128 ? kind : kind + 128;
+	}
+
+	// Value of the text of a numeric literal: digits, digits followed by 'u', or digits with a fraction
+	// Converted without locale or allocation, on overflow the value saturates and false is returned
+	// Floats too small for a double become the nearest denormal or 0
+	// Integer literals are signed 64-bit, unsigned and float literals use their whole range
+	inline static bool
+	literal_parse(std::string_view text, Literal &value)
+	{
+		auto first = text.data(), last = text.data() + text.size();
+		if (text.find('.') != std::string_view::npos)
+		{
+			auto [ptr, ec] = std::from_chars(first, last, value.f64);
+			if (ec != std::errc::result_out_of_range)
+				return true;
+
+			// Out of range below 1 is an underflow, which rounds to 0 like any other float
+			if (text.find_first_not_of('0') == text.find('.'))
+			{
+				value.f64 = 0;
+				return true;
+			}
+
+			value.f64 = std::numeric_limits<double>::max();
+			return false;
+		}
+
+		bool is_unsigned = text.ends_with('u');
+		auto max = is_unsigned ? UINT64_MAX : (uint64_t)INT64_MAX;
+
+		uint64_t u64 = 0;
+		auto [ptr, ec] = std::from_chars(first, last - is_unsigned, u64);
+		if (ec == std::errc::result_out_of_range || u64 > max)
+		{
+			value.u64 = max;
+			return false;
+		}
+
+		value.u64 = u64;
+		return true;
+	}
+
+	// Lexed source in structure of arrays form, the parser consumes it through yylex
+	// Token i is kinds[i], offsets[i], lengths[i] and values[i], the last token ends the input
+	// Kept across compilations, with Parser::reuse_tokens the same code is not lexed again
+	struct Token_Stream
+	{
+		std::vector<uint8_t> kinds;			// packed Bison token kinds
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> lengths;
+		std::vector<uint64_t> values;		// literal payload, index into names for identifiers
+		std::vector<Source_Location> names;	// first occurrence of each distinct identifier
+
+		Hash_128 hash;						// hash of the lexed code, only computed when tokens are reused
+		size_t code_size;
+
+		inline size_t count() const { return kinds.size(); }
+	};
+
+	inline static void
+	token_stream_push(Token_Stream &self, int kind, Source_Location loc, uint64_t value)
+	{
+		self.kinds.push_back(token_kind_pack(kind));
+		self.offsets.push_back(loc.offset);
+		self.lengths.push_back(loc.length);
+		self.values.push_back(value);
+	}
+
+	inline static void
+	token_stream_append(Token_Stream &self, const Token_Stream &other)
+	{
+		self.kinds.insert(self.kinds.end(), other.kinds.begin(), other.kinds.end());
+		self.offsets.insert(self.offsets.end(), other.offsets.begin(), other.offsets.end());
+		self.lengths.insert(self.lengths.end(), other.lengths.begin(), other.lengths.end());
+		self.values.insert(self.values.end(), other.values.begin(), other.values.end());
+	}
+
+	inline static void
+	token_stream_clear(Token_Stream &self)
+	{
+		self.kinds.clear();
+		self.offsets.clear();
+		self.lengths.clear();
+		self.values.clear();
+		self.names.clear();
+		self.hash = {};
+		self.code_size = 0;
+	}
+
+	// Sources at least twice this size are split at line breaks and lexed in parallel
+	constexpr size_t LEXER_CHUNK_MIN = 256 * 1024;
+
 	// Defined in Lexer.l
-	// Scan a null-terminated in-memory buffer
+	// Create a reentrant scanner, the scanner does not touch any compilation state
+	// Returns nullptr on failure
+	yyscan_t
+	lexer_new();
+
+	void
+	lexer_free(yyscan_t scanner);
+
+	// Scan a caller-owned buffer in place, buf_size includes the LEXER_PADDING null bytes that must end it
+	// Returns nullptr if the padding is missing
 	YY_BUFFER_STATE
-	lexer_scan_buffer(char *buf, size_t buf_size);
+	lexer_scan_buffer(yyscan_t scanner, char *buf, size_t buf_size);
 
-	// Cleanup allocated buffer
+	// Scan a copy of the bytes, no padding is needed
+	YY_BUFFER_STATE
+	lexer_scan_bytes(yyscan_t scanner, const char *bytes, size_t size);
+
+	// Lex the scanned buffer to its end, appending the tokens with their offsets moved by base
+	// Identifiers are left unresolved, end is set to the location of the last lexeme that is not a line break, if any
+	void
+	lexer_tokenize(yyscan_t scanner, uint32_t base, Token_Stream &tokens, Source_Location &end);
+
+	// Give every identifier token the index of its name, single threaded
 	void
-	lexer_delete_buffer(YY_BUFFER_STATE buf);
+	lexer_resolve_names(Token_Stream &tokens, std::string_view code);
+
+	// Cleanup the buffer state, the scanned buffer is not freed
+	void
+	lexer_delete_buffer(yyscan_t scanner, YY_BUFFER_STATE buf);
+
+	// Lexers producing the token stream, both give the same tokens and locations
+	enum class Lexer_Engine : uint8_t
+	{
+		FLEX,	// generated from Lexer.l
+		SIMD,	// hand-written, scans runs of characters 16 bytes at a time
+	};
+
+	// Defined in Lexer_Simd.cpp
+	// Lex size bytes of code like lexer_tokenize, the code is only read and needs no padding
+	// Chunks of a source must end after a line break, as they do for the flex scanner
+	void
+	lexer_simd_tokenize(const char *code, size_t size, uint32_t base, Token_Stream &tokens, Source_Location &end);
+
+	// Larger files are shown read only, ImGui's text editor processes the whole buffer every frame
+	constexpr size_t UI_SOURCE_EDIT_MAX = 1 << 20;
 
 	// UI buffer which holds the source code
 	struct UI_Source_Code
 	{
-		char buf[1<<13 + 2];// 8KB + 2 needed by flex
+		std::vector<char> buf;	// editable code, the last LEXER_PADDING bytes are kept for flex
 		size_t count;
+
+		Source_Buffer file;		// loaded file too large to edit, compiled in place
+		Line_Table file_lines;	// lines of the read only view
+	};
+
+	enum class Log_Level
+	{
+		INFO,
+		WARNING,
+		ERROR,
+		CRITICAL,
+	};
+
+	// Logged diagnostic, formatted only when displayed
+	struct Log
+	{
+		Error err;
+		Log_Level lvl;
+		bool show_level;	// messages reported through yyerror are shown as is
+		uint32_t source;	// source snapshot the location refers to
+		uint32_t code;		// offset of the copied source line in the snapshot
+		uint32_t code_size;
+	};
+
+	// Snapshot of the source code logs point into, only the logged lines are copied
+	struct Log_Source
+	{
+		std::string code;	// copied lines
+		Line_Table lines;	// lines of the whole source, built when the snapshot is taken
+	};
+
+	// Single line in the Logs window
+	// Logs with a location span 3 lines: message, source line and indicator
+	struct UI_Log
+	{
+		uint32_t log;		// index into logs
+		uint32_t line;
+	};
+
+	// Handle to an error in the compilation's diagnostics table
+	// 0 is reserved for no error
+	struct Diag_Id
+	{
+		uint32_t idx;
+
+		inline explicit operator bool() const	{ return idx != 0; }
+		inline bool operator==(bool v) const	{ return bool(*this) == v; }
+		inline bool operator!=(bool v) const	{ return !operator==(v); }
 	};
 
 	// Main entity that represents expressions, parser non-terminals are of this type
+	// Kept to a few words as it lives on the Bison value stack
 	struct Parse_Unit
 	{
 		Semantic_Expr semexpr;	// carries semantic information
+		Diag_Id err;			// whether the unit has encountered errors
 		AST ast;				// AST representation
 		Source_Location loc;	// location in the source file
-		Error err;				// whether the unit has encountered errors
 	};
 
 	// Parser token type
 	union YY_Symbol
 	{
-		String id;					// identifiers
+		Str_Id id;				// identifiers
 		Literal value;			// literals
 		Semantic_Expr type;		// variable types
 		Parse_Unit unit;		// main non-terminals
 	};
 
+	// Measurements of the last compilation
+	struct Parser_Stats
+	{
+		// Phases, they do not overlap
+		std::chrono::nanoseconds lex;		// lexing, only hashing the code when the previous tokens were reused
+		std::chrono::nanoseconds parse;		// parsing with the semantic actions
+		std::chrono::nanoseconds codegen;	// backend_compile
+		std::chrono::nanoseconds optimize;	// backend_optimize
+		std::chrono::nanoseconds emit;		// formatting the quadruples for display or output
+
+		size_t tokens;						// including the end of input
+		bool tokens_reused;
+		size_t nodes[AST_KIND_COUNT];		// AST nodes built, by kind
+		size_t sym_lookups;					// scope_get_sym calls
+		size_t sym_probes;					// index slots they inspected, over all the scopes searched
+		size_t arena_bytes;
+		size_t quadruples;
+		size_t quadruples_removed;			// by the optimizer, not counted in quadruples
+		size_t peephole_removed;			// by the peephole pass after it
+	};
+
+	// Adds the time until the end of its scope to a phase
+	struct Phase_Timer
+	{
+		std::chrono::nanoseconds &phase;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		inline ~Phase_Timer() { phase += std::chrono::steady_clock::now() - start; }
+	};
+
+	// Sum of the measurements of several compilations
+	inline static void
+	parser_stats_add(Parser_Stats &self, const Parser_Stats &other)
+	{
+		self.lex += other.lex;
+		self.parse += other.parse;
+		self.codegen += other.codegen;
+		self.optimize += other.optimize;
+		self.emit += other.emit;
+		self.tokens += other.tokens;
+		self.tokens_reused |= other.tokens_reused;
+		for (size_t i = 0; i < AST_KIND_COUNT; i++)
+			self.nodes[i] += other.nodes[i];
+		self.sym_lookups += other.sym_lookups;
+		self.sym_probes += other.sym_probes;
+		self.arena_bytes += other.arena_bytes;
+		self.quadruples += other.quadruples;
+		self.quadruples_removed += other.quadruples_removed;
+		self.peephole_removed += other.peephole_removed;
+	}
+
+	inline static size_t
+	parser_stats_nodes(const Parser_Stats &self)
+	{
+		size_t count = 0;
+		for (auto n : self.nodes)
+			count += n;
+		return count;
+	}
+
 	struct Parser
 	{
 		/* Bison semantic action hooks */
@@ -83,13 +351,13 @@ namespace s22
 		literal(Source_Location loc, Literal lit, Semantic_Expr::BASE base);
 
 		Parse_Unit
-		id(Source_Location loc, const String &id);
+		id(Source_Location loc, Str_Id id);
 
 		Parse_Unit
-		array_access(Source_Location loc, const String &id, const Parse_Unit &right);
+		array_access(Source_Location loc, Str_Id id, const Parse_Unit &right);
 
 		Parse_Unit
-		assign(Source_Location loc, const String &id, Asn op, const Parse_Unit &right);
+		assign(Source_Location loc, Str_Id id, Asn op, const Parse_Unit &right);
 
 		Parse_Unit
 		array_assign(Source_Location loc, const Parse_Unit &left, Asn op, const Parse_Unit &right);
@@ -107,16 +375,16 @@ namespace s22
 		pcall_add(const Parse_Unit &arg);
 
 		Parse_Unit
-		pcall(Source_Location loc, const String &id);
+		pcall(Source_Location loc, Str_Id id);
 
 		Parse_Unit
-		decl(Source_Location loc, const String &id, Semantic_Expr type);
+		decl(Source_Location loc, Str_Id id, Semantic_Expr type);
 
 		Parse_Unit
-		decl_expr(Source_Location loc, const String &id, Semantic_Expr type, const Parse_Unit &right);
+		decl_expr(Source_Location loc, Str_Id id, Semantic_Expr type, const Parse_Unit &right);
 
 		Parse_Unit
-		decl_const(Source_Location loc, const String &id, Semantic_Expr type, const Parse_Unit &right);
+		decl_const(Source_Location loc, Str_Id id, Semantic_Expr type, const Parse_Unit &right);
 
 		void
 		decl_proc_begin();
@@ -125,10 +393,10 @@ namespace s22
 		decl_proc_params_add(const Parse_Unit &arg);
 
 		void
-		decl_proc_params_end(Source_Location loc, const String &id, const Semantic_Expr &ret);
+		decl_proc_params_end(Source_Location loc, Str_Id id, const Semantic_Expr &ret);
 
 		Parse_Unit
-		decl_proc_end(const String &id);
+		decl_proc_end(Str_Id id);
 
 		Parse_Unit
 		if_cond(const Parse_Unit &cond, const Parse_Unit &block, const Parse_Unit &next);
@@ -172,25 +440,78 @@ namespace s22
 		{
 			Scope *scope;
 			std::vector<Parse_Unit> proc_call_arguments;
-			std::vector<Decl *> decl_proc_arguments;
+			std::vector<AST> decl_proc_arguments;
 			std::vector<AST> block_stmts;
 			size_t stack_offset;
 
 			struct Sw_Case
 			{
-				std::vector<Literal *> group;
-				Switch_Case *ast_sw_case;
+				std::vector<AST> group;
+				AST ast_sw_case;
 			};
 			AST switch_expr;
 			std::vector<Sw_Case> switch_cases;
-			Block *switch_default;
+			AST switch_default;
+		};
+
+		// Stack of contexts that keeps popped frames, their vectors keep their capacity for the next push
+		// A popped frame stays valid until the next push
+		struct Context_Stack
+		{
+			std::deque<Context> frames;	// frames[0, count) are live, a deque so pushing never moves a frame
+			size_t count;
+
+			inline bool empty() const	{ return count == 0; }
+			inline Context &top()		{ return frames[count - 1]; }
+			inline void pop()			{ count--; }
+
+			inline Context &
+			emplace()
+			{
+				if (count == frames.size())
+				{
+					count++;
+					return frames.emplace_back();
+				}
+
+				auto &self = frames[count++];
+				self.scope = nullptr;
+				self.proc_call_arguments.clear();
+				self.decl_proc_arguments.clear();
+				self.block_stmts.clear();
+				self.stack_offset = 0;
+				self.switch_expr = {};
+				self.switch_cases.clear();
+				self.switch_default = {};
+				return self;
+			}
 		};
-		std::stack<Context> context;
+		Context_Stack context;
 		Scope global;
-		Backend backend;
+		Backend backend;	// owned, created by the first compilation
+		yyscan_t scanner;	// owned, created by the first compilation
+		Pool pool;			// not owned, lexes large sources in parallel when set
+		Lexer_Engine lexer;	// lexer of the next compilation
+		bool unoptimized;	// keep the quadruples as generated, skipping backend_optimize
+		bool reuse_tokens;	// hash the code to skip lexing it again when it did not change, e.g. in the editor
+		std::string_view source; // code of the current compilation, without the padding
+		Token_Stream tokens; // tokens of the source, kept for the next compilation
+		size_t token_next;	// next token handed to the parser
+		std::vector<Str_Id> token_names; // interned names of the tokens, filled as they are consumed
+		Parser_Stats stats;
+		Arena arena;		// buffers and procedure types of the current compilation
+		AST_Pool asts;		// AST nodes of the current compilation
+		Str_Table strings;	// interned identifiers and labels, stored in the arena
+		Type_Table types;	// interned types, procedure signatures are stored in the arena
+		std::vector<Error> diagnostics; // errors referenced by Parse_Unit::err, index 0 is reserved
 		
 		// UI elements
-		std::vector<std::string> ui_logs;
+		std::vector<Log> logs;					// kept across compilations until cleared
+		std::vector<Log_Source> log_sources;	// snapshots of the source code that logs refer to
+		bool log_source_taken;					// whether the current compilation has a snapshot
+		const Line_Table *log_lines;			// lines of the snapshot being formatted, locations resolve against it
+		Line_Table source_lines;				// lines of the current compilation, built on the first lookup
+		std::vector<UI_Log> ui_logs;
 		UI_Source_Code ui_source_code;
 		UI_Program ui_program;
 		UI_Symbol_Table ui_table;
@@ -198,24 +519,82 @@ namespace s22
 		bool has_errors;
 	};
 
-	enum class Log_Level
-	{
-		INFO,
-		WARNING,
-		ERROR,
-		CRITICAL,
-	};
-
-	// Parser singleton instance
+	// Parser of the calling thread, set by parser_bind
+	// Threads which never bound a parser share the application's parser
 	Parser*
 	parser_instance();
 
+	// Make self the parser of the calling thread, returns the previously bound parser
+	// The arena, string, type and AST hooks resolve against the bound parser
+	Parser*
+	parser_bind(Parser *self);
+
+	// Compile code into self, previous compilation data is discarded
+	// code must be followed by LEXER_PADDING null bytes, it is scanned in place
+	// Each thread may run its own compilation, a parser must only be used by one thread at a time
+	// Returns true when the program compiled without errors
+	bool
+	parser_compile(Parser *self, char *code, size_t size);
+
 	// Log an error, uses the error's location
 	void
 	parser_log(const Error &err, Log_Level lvl = Log_Level::ERROR);
+
+	// Format a single line of the Logs window
+	std::string
+	parser_log_line(size_t i);
+
+	void
+	parser_log_clear();
+
+	// Store an error in the diagnostics table of the current compilation
+	Diag_Id
+	diag_push(const Error &err);
+
+	const Error &
+	diag_get(Diag_Id id);
 }
 
 // Error handler used by Bison/Flex
-// Uses parser_log
+// Logs the message as is
 void
 yyerror(const s22::Source_Location *location, s22::Parser *p, const char *message);
+
+template <>
+struct std::formatter<s22::Log_Level> : std::formatter<std::string>
+{
+	auto
+	format(s22::Log_Level lvl, format_context &ctx)
+	{
+		const char *str = "UNREACHABLE";
+		switch (lvl)
+		{
+		case s22::Log_Level::INFO:    str = "INFO"; break;
+		case s22::Log_Level::ERROR:   str = "ERROR"; break;
+		case s22::Log_Level::WARNING: str = "WARNING"; break;
+
+		default:
+			break;
+		}
+
+		return format_to(ctx.out(), "{}", str);
+	}
+};
+
+// One line summary, shown in the Logs window
+template <>
+struct std::formatter<s22::Parser_Stats> : std::formatter<std::string>
+{
+	auto
+	format(const s22::Parser_Stats &stats, format_context &ctx)
+	{
+		auto ms = [](std::chrono::nanoseconds t) { return t.count() / 1e6; };
+		return format_to(ctx.out(),
+			"lex {:.2f} ms, parse {:.2f} ms, codegen {:.2f} ms, optimize {:.2f} ms, emit {:.2f} ms | {} tokens{}, {} nodes, {} lookups ({:.2f} probes each), {} KB arena, {} quadruples ({} optimized away, {} by peephole)",
+			ms(stats.lex), ms(stats.parse), ms(stats.codegen), ms(stats.optimize), ms(stats.emit),
+			stats.tokens, stats.tokens_reused ? " (reused)" : "", s22::parser_stats_nodes(stats),
+			stats.sym_lookups, stats.sym_lookups ? (double)stats.sym_probes / stats.sym_lookups : 0.0,
+			stats.arena_bytes / 1024, stats.quadruples, stats.quadruples_removed, stats.peephole_removed
+		);
+	}
+};
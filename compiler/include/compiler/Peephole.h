@@ -0,0 +1,13 @@
+#pragma once
+#include "compiler/Backend.h"
+
+namespace s22
+{
+	// Clean up the branches and labels left by code generation
+	// Threads branches to unconditional branches, removes branches to the next instruction, drops unused
+	// labels and moves the rest onto the instruction they fall into, merging labels of the same instruction
+	// Procedure labels stay where they are
+	// Returns the number of quadruples removed
+	size_t
+	peephole_optimize(Program &program);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+
+namespace s22
+{
+	struct IPool;
+	using Pool = IPool*;
+
+	// Job i of a batch, worker is the index of the thread running it
+	using Pool_Job = std::function<void(size_t i, size_t worker)>;
+
+	// Work-stealing pool of worker threads, 0 starts one worker per hardware thread
+	Pool
+	pool_new(size_t worker_count = 0);
+
+	// Joins the workers, the pool must be idle
+	void
+	pool_free(Pool self);
+
+	size_t
+	pool_worker_count(Pool self);
+
+	// Run job for every i in [0, count) and wait for all of them to finish
+	// Each worker starts with a contiguous run of indices, a worker that runs dry steals from the back of the others
+	// Jobs with the same worker index never overlap, they can share per worker state
+	// Must not be called from inside a job
+	void
+	pool_for(Pool self, size_t count, const Pool_Job &job);
+}
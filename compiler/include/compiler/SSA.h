@@ -0,0 +1,13 @@
+#pragma once
+#include "compiler/Backend.h"
+
+namespace s22
+{
+	// Optimize program through static single assignment form, one procedure at a time
+	// Sparse conditional constant propagation folds constants, prunes the branches that are never taken
+	// and removes unreachable blocks and dead temporaries, then the program leaves SSA form with
+	// every version of a variable coalesced back into it
+	// Returns the number of quadruples removed
+	size_t
+	ssa_optimize(Program &program);
+}
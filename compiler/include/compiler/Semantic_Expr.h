@@ -13,10 +13,11 @@ namespace s22
 	struct Procedure;
 
 	// Semantic expression types
+	// Handle to an interned type, equal types share the same handle
 	struct Semantic_Expr
 	{
 		// Base type
-		enum BASE
+		enum BASE : uint8_t
 		{
 			VOID,
 			PROC,
@@ -26,55 +27,80 @@ namespace s22
 			FLOAT,
 			BOOL,
 		};
-		BASE base;
 
-		size_t array;					// array size, 0 if not an array
+		uint32_t idx;					// index into the type table, base types are seeded at idx == BASE
 		bool is_literal;				// true if a literal
-		Optional<Procedure> procedure;	// optional value if symbol represents a procedure
 
-		inline bool
-		operator==(const Semantic_Expr &other) const
-		{
-			if (base != other.base)
-				return false;
-
-			if (array != other.array)
-				return false;
-
-			if (procedure != other.procedure)
-				return false;
-
-			return true;
-		}
-
-		inline bool
-		operator!=(const Semantic_Expr &other) const { return !operator==(other); }
+		inline bool operator==(const Semantic_Expr &other) const	{ return idx == other.idx; }
+		inline bool operator!=(const Semantic_Expr &other) const	{ return !operator==(other); }
 	};
 
-	constexpr Semantic_Expr SEMEXPR_VOID  = { .base = Semantic_Expr::VOID  };
-	constexpr Semantic_Expr SEMEXPR_INT   = { .base = Semantic_Expr::INT   };
-	constexpr Semantic_Expr SEMEXPR_UINT  = { .base = Semantic_Expr::UINT  };
-	constexpr Semantic_Expr SEMEXPR_FLOAT = { .base = Semantic_Expr::FLOAT };
-	constexpr Semantic_Expr SEMEXPR_BOOL  = { .base = Semantic_Expr::BOOL  };
+	constexpr Semantic_Expr SEMEXPR_VOID  = { .idx = Semantic_Expr::VOID  };
+	constexpr Semantic_Expr SEMEXPR_INT   = { .idx = Semantic_Expr::INT   };
+	constexpr Semantic_Expr SEMEXPR_UINT  = { .idx = Semantic_Expr::UINT  };
+	constexpr Semantic_Expr SEMEXPR_FLOAT = { .idx = Semantic_Expr::FLOAT };
+	constexpr Semantic_Expr SEMEXPR_BOOL  = { .idx = Semantic_Expr::BOOL  };
 
 	struct Procedure
 	{
 		Buf<Semantic_Expr> parameters;
 		Semantic_Expr return_type;
+	};
 
-		inline bool
-		operator==(const Procedure &other) const
-		{
-			if (parameters != other.parameters)
-				return false;
-
-			if (return_type != other.return_type)
-				return false;
+	// Structure of an interned type
+	struct Type_Info
+	{
+		Semantic_Expr::BASE base;
+		uint64_t array;					// array size, 0 if not an array
+		const Procedure *procedure;		// set if type represents a procedure
+	};
 
-			return true;
-		}
+	// Type table of the current compilation, every distinct type is stored once
+	// Procedure signatures live in the compilation's arena
+	struct Type_Table
+	{
+		std::unordered_multimap<uint64_t, uint32_t> lookup;	// structural hash -> index
+		std::vector<Type_Info> types;						// indexed by Semantic_Expr::idx
 	};
 
+	// Type table of the current compilation
+	// Defined in Parser.cpp
+	Type_Table *
+	type_table_instance();
+
+	// Must accompany an arena reset, as procedure signatures live in the arena
+	void
+	type_table_clear(Type_Table *self);
+
+	const Type_Info &
+	semexpr_info(Semantic_Expr semexpr);
+
+	// Interns an array of the given base type, size 0 yields the base type itself
+	Semantic_Expr
+	semexpr_array_of(Semantic_Expr::BASE base, uint64_t size);
+
+	// Interns a procedure signature, parameters are copied on first use
+	Semantic_Expr
+	semexpr_proc(const Buf<Semantic_Expr> &parameters, Semantic_Expr return_type);
+
+	inline static Semantic_Expr::BASE
+	semexpr_base(Semantic_Expr semexpr)
+	{
+		return semexpr_info(semexpr).base;
+	}
+
+	inline static uint64_t
+	semexpr_array(Semantic_Expr semexpr)
+	{
+		return semexpr_info(semexpr).array;
+	}
+
+	inline static const Procedure *
+	semexpr_procedure(Semantic_Expr semexpr)
+	{
+		return semexpr_info(semexpr).procedure;
+	}
+
 	enum class Asn
 	{
 		MOV = I_MOV, // A = B
@@ -132,23 +158,23 @@ namespace s22
 	};
 
 	bool
-	semexpr_allows_arithmetic(const Semantic_Expr &semexpr);
+	semexpr_allows_arithmetic(Semantic_Expr semexpr);
 
 	bool
-	semexpr_is_integral(const Semantic_Expr &semexpr);
+	semexpr_is_integral(Semantic_Expr semexpr);
 
 	void
-	semexpr_print(const Semantic_Expr &semexpr, FILE *out);
+	semexpr_print(Semantic_Expr semexpr, FILE *out);
 
 	// Constructors for different types
 	Result<Semantic_Expr>
 	semexpr_literal(Scope *scope, Literal lit, Semantic_Expr::BASE base);
 
 	Result<Semantic_Expr>
-	semexpr_id(Scope *scope, const char *id);
+	semexpr_id(Scope *scope, Str_Id id);
 
 	Result<Semantic_Expr>
-	semexpr_assign(Scope *scope, const char *id, const Parse_Unit &right, Asn op);
+	semexpr_assign(Scope *scope, Str_Id id, const Parse_Unit &right, Asn op);
 
 	Result<Semantic_Expr>
 	semexpr_array_assign(Scope *scope, const Parse_Unit &left, const Parse_Unit &right, Asn op);
@@ -160,41 +186,42 @@ namespace s22
 	semexpr_unary(Scope *scope, const Parse_Unit &right, Uny op);
 
 	Result<Semantic_Expr>
-	semexpr_array_access(Scope *scope, const char *id, const Parse_Unit &expr);
+	semexpr_array_access(Scope *scope, Str_Id id, const Parse_Unit &expr);
 
 	Result<Semantic_Expr>
-	semexpr_proc_call(Scope *scope, const char *id, const Buf<Parse_Unit> &params);
+	semexpr_proc_call(Scope *scope, Str_Id id, const Buf<Parse_Unit> &params);
 }
 
 template <>
 struct std::formatter<s22::Semantic_Expr> : std::formatter<std::string>
 {
 	auto
-	format(const s22::Semantic_Expr &type, format_context &ctx)
+	format(s22::Semantic_Expr type, format_context &ctx)
 	{
 		using namespace s22;
-		if (type.procedure)
+		auto &info = semexpr_info(type);
+		if (info.procedure)
 		{
 			format_to(ctx.out(), "proc(");
 			{
-				format_to(ctx.out(), "{}", type.procedure->parameters);
+				format_to(ctx.out(), "{}", info.procedure->parameters);
 			}
 			format_to(ctx.out(), ")");
 
-			if (type.procedure->return_type != SEMEXPR_VOID)
+			if (info.procedure->return_type != SEMEXPR_VOID)
 			{
 				format_to(ctx.out(), " -> ");
-				format_to(ctx.out(), "{}", type.procedure->return_type);
+				format_to(ctx.out(), "{}", info.procedure->return_type);
 			}
 		}
 		else
 		{
-			if (type.array)
+			if (info.array)
 			{
-				format_to(ctx.out(), "[{}]", type.array);
+				format_to(ctx.out(), "[{}]", info.array);
 			}
 
-			switch (type.base)
+			switch (info.base)
 			{
 			case s22::Semantic_Expr::INT: return format_to(ctx.out(), "int");
 			case s22::Semantic_Expr::UINT: return format_to(ctx.out(), "uint");
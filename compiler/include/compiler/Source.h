@@ -0,0 +1,28 @@
+#pragma once
+
+#include "compiler/Util.h"
+
+namespace s22
+{
+	// Null bytes flex requires at the end of a scanned buffer
+	constexpr size_t LEXER_PADDING = 2;
+
+	// Locations are 32-bit offsets into the source
+	constexpr size_t SOURCE_SIZE_MAX = UINT32_MAX - LEXER_PADDING;
+
+	// Source code ready to be scanned in place, size bytes followed by LEXER_PADDING null bytes
+	// Files are mapped copy-on-write where supported, the lexer's writes never reach the file
+	struct Source_Buffer
+	{
+		char *data;
+		size_t size;
+		size_t mapped;	// bytes mapped, 0 if data is heap allocated
+	};
+
+	// Load a file without copying it where the platform supports mapping
+	Result<Source_Buffer>
+	source_load(const char *path);
+
+	void
+	source_free(Source_Buffer &self);
+}
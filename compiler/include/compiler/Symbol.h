@@ -13,7 +13,7 @@ namespace s22
 
 	struct Symbol
 	{
-		String id;
+		Str_Id id;
 		Semantic_Expr type;
 		Source_Location defined_at;
 
@@ -22,10 +22,32 @@ namespace s22
 		bool is_used;
 	};
 
+	// Open-addressing index from an identifier to its symbol and the symbol's position in the scope table
+	// Slots live in the compilation's arena, empty slots have a null id
+	struct Scope_Index
+	{
+		struct Slot
+		{
+			Str_Id id;
+			uint32_t entry;	// position in Scope::table
+			Symbol *sym;
+		};
+		Slot *slots;
+		uint32_t cap;	// power of 2
+		uint32_t count;
+	};
+
+	// Symbols and scopes are allocated in the compilation's arena, their addresses are stable
 	struct Scope
 	{
-		using Entry = std::variant<Symbol, Scope>;
-		std::vector<Entry> table;
+		// Either a symbol or a nested scope
+		struct Entry
+		{
+			Symbol *sym;
+			Scope *scope;
+		};
+		Arena_List<Entry> table;
+		Scope_Index index; // symbols of the table by identifier
 
 		Scope *parent_scope;
 		size_t idx_in_parent_table; // index of current scope in the parent scope, used to track use before declaration in upper scopes
@@ -44,12 +66,12 @@ namespace s22
 	scope_add_decl(Scope *self, const Symbol &symbol, const Parse_Unit &expr);
 
 	// Declare procedure in this scope's parent
-	// Pops the scope, replacing it with its parent
+	// The scope is moved after the procedure symbol in its parent's table
 	Result<Symbol *>
-	scope_add_decl_proc(Scope *&self, const Symbol &symbol);
+	scope_add_decl_proc(Scope *self, const Symbol &symbol);
 
 	// Builds a procedure, sets its arguments to all variables defined so far in the scope
-	Procedure
+	Semantic_Expr
 	scope_make_proc(Scope *self, Semantic_Expr return_type);
 
 	// Push new scope, modifying the passed pointer and returning the old pointer
@@ -66,7 +88,7 @@ namespace s22
 
 	// Return the symbol represented by the identifier, nullptr if not found
 	Symbol *
-	scope_get_sym(Scope *self, const char *id);
+	scope_get_sym(Scope *self, Str_Id id);
 
 	// symbol_id, symbol_type, symbol_location, symbol flags
 	using UI_Symbol_Row = std::array<std::string, 4>;
@@ -1,39 +1,93 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <format>
-#include <unordered_set>
+#include <algorithm>
+#include <cstring>
 #include <unordered_map>
 
 namespace s22
 {
-	// RAII memory manager
-	struct Memory_Log
+	// Chunked bump-pointer allocator, each compilation owns one
+	// Memory is released in bulk by arena_reset, chunks are kept for the next compilation
+	struct Arena
 	{
-		std::unordered_set<void *> log;
+		struct Chunk
+		{
+			Chunk *next;
+			size_t cap;		// usable bytes following the chunk header
+			size_t used;
+		};
 
-		inline static Memory_Log *
-		instance() { static Memory_Log log = {}; return &log; }
+		constexpr static size_t CHUNK_SIZE = 64 * 1024;
 
-		inline void
-		free_all()
-		{
-			if (this->log.empty()) return;
-			for (auto ptr : log) free(ptr);
-			this->log.clear();
-		}
+		Chunk *head;			// first chunk, allocation restarts from here after a reset
+		Chunk *current;			// chunk being bumped
 
-		inline ~Memory_Log() { this->free_all(); };
+		size_t bytes_reserved;	// bytes acquired from the system
+		size_t bytes_used;		// bytes handed out since the last reset, including alignment padding
 	};
 
+	// Arena of the current compilation, used by alloc
+	// Defined in Parser.cpp
+	Arena *
+	arena_instance();
+
+	inline static void *
+	arena_push(Arena *self, size_t size, size_t align)
+	{
+		while (true)
+		{
+			if (auto chunk = self->current)
+			{
+				auto base = (uintptr_t)(chunk + 1);
+				auto ptr = (base + chunk->used + align - 1) & ~(uintptr_t)(align - 1);
+				if (ptr + size <= base + chunk->cap)
+				{
+					self->bytes_used += ptr + size - (base + chunk->used);
+					chunk->used = ptr + size - base;
+					return (void *)ptr;
+				}
+
+				// Reuse chunks retained from previous compilations
+				if (chunk->next && chunk->next->cap >= size + align)
+				{
+					self->current = chunk->next;
+					self->current->used = 0;
+					continue;
+				}
+			}
+
+			// Grow, linking the new chunk right after the current one
+			size_t cap = std::max(Arena::CHUNK_SIZE, size + align);
+			auto chunk = (Arena::Chunk *)malloc(sizeof(Arena::Chunk) + cap);
+			chunk->cap = cap;
+			chunk->used = 0;
+
+			if (self->current == nullptr)
+			{
+				chunk->next = self->head;
+				self->head = chunk;
+			}
+			else
+			{
+				chunk->next = self->current->next;
+				self->current->next = chunk;
+			}
+			self->current = chunk;
+			self->bytes_reserved += cap;
+		}
+	}
+
+	// Zero initialized, aligned allocation of count elements
 	template <typename T>
 	inline static T *
-	alloc(size_t count = 1)
+	arena_alloc(Arena *self, size_t count = 1)
 	{
-		auto mem = Memory_Log::instance();
-
-		auto ptr = (T*)calloc(count, sizeof(T));
-		mem->log.insert(ptr);
+		auto ptr = (T *)arena_push(self, count * sizeof(T), alignof(T));
+		::memset(ptr, 0, count * sizeof(T));
 
 		if (count == 1)
 			*ptr = T{};
@@ -41,35 +95,161 @@ namespace s22
 		return ptr;
 	}
 
+	// Releases all allocations at once, keeps the chunks
+	inline static void
+	arena_reset(Arena *self)
+	{
+		if (self->head)
+			self->head->used = 0;
+
+		self->current = self->head;
+		self->bytes_used = 0;
+	}
+
+	// Returns all chunks to the system
+	inline static void
+	arena_free(Arena *self)
+	{
+		for (auto chunk = self->head; chunk != nullptr;)
+		{
+			auto next = chunk->next;
+			::free(chunk);
+			chunk = next;
+		}
+		*self = {};
+	}
+
+	template <typename T>
+	inline static T *
+	alloc(size_t count = 1)
+	{
+		return arena_alloc<T>(arena_instance(), count);
+	}
+
+	// Byte range in the source code, lines and columns are resolved on demand through a Line_Table
 	struct Source_Location
 	{
-		int first_line, first_column;
-		int last_line, last_column;
+		uint32_t offset;
+		uint32_t length;
+
+		Source_Location() = default;
+		constexpr Source_Location(uint32_t offset, uint32_t length) : offset(offset), length(length) {}
+
+		// Bison seeds the first location with {1, 1, 1, 1}, taken as the empty range at the start of the code
+		constexpr Source_Location(int, int, int, int) : offset(0), length(0) {}
 
 		inline bool
 		operator==(const Source_Location &other) const
 		{
-			return first_line   == other.first_line &&
-				   first_column == other.first_column &&
-				   last_line    == other.last_line &&
-				   last_column  == other.last_column;
+			return offset == other.offset && length == other.length;
 		}
 
 		inline bool
 		operator !=(const Source_Location &other) const { return !operator==(other); }
 	};
 
+	// Location that points nowhere, e.g. of errors not tied to the code, {0, 0} is the empty range at the start
+	constexpr Source_Location LOCATION_NONE = { UINT32_MAX, 0 };
+
+	// Offset of the last character of a location
+	inline static uint32_t
+	location_last(Source_Location loc)
+	{
+		return loc.length > 0 ? loc.offset + loc.length - 1 : loc.offset;
+	}
+
 	// Reduces locations of the rhs of a production to the current
 	void
 	location_reduce(Source_Location &current, Source_Location *rhs, size_t N);
 
-	// Used by the lexer, sets the given location to the current token
-	void
-	location_update(Source_Location *loc);
-
 	void
 	location_print(FILE *out, const Source_Location *loc);
 
+	// 1-based line and column
+	struct Line_Col
+	{
+		uint32_t line;
+		uint32_t column;
+	};
+
+	// Offsets of the beginning of each line of a source buffer
+	struct Line_Table
+	{
+		std::vector<uint32_t> starts;
+	};
+
+	inline static void
+	line_table_build(Line_Table *self, const char *source, size_t count)
+	{
+		self->starts.clear();
+		self->starts.push_back(0);
+
+		for (auto c = source, end = source + count; (c = (const char *)::memchr(c, '\n', end - c)) != nullptr; c++)
+			self->starts.push_back(uint32_t(c - source + 1));
+	}
+
+	// Binary search for the line containing the offset
+	inline static Line_Col
+	line_table_find(const Line_Table *self, uint32_t offset)
+	{
+		auto it = std::upper_bound(self->starts.begin(), self->starts.end(), offset);
+		auto line = (uint32_t)(it - self->starts.begin());
+
+		Line_Col pos = { .line = line, .column = offset - self->starts[line - 1] + 1 };
+		return pos;
+	}
+
+	// 128-bit hash of a buffer, long enough that different code of the same size does not collide
+	struct Hash_128
+	{
+		uint64_t lo, hi;
+
+		inline bool
+		operator==(const Hash_128 &other) const
+		{
+			return lo == other.lo && hi == other.hi;
+		}
+	};
+
+	// Murmur3's finalizer, every input bit affects every output bit
+	inline static uint64_t
+	hash_mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		return h ^ (h >> 33);
+	}
+
+	// Two lanes over sixteen bytes at a time, each lane feeds the other
+	inline static Hash_128
+	hash_bytes(const char *data, size_t size)
+	{
+		uint64_t a = size ^ 0x9E3779B97F4A7C15ull;
+		uint64_t b = size ^ 0xC2B2AE3D27D4EB4Full;
+
+		uint64_t w[2];
+		size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			::memcpy(w, data + i, 16);
+			a = hash_mix(a ^ w[0]) + b;
+			b = hash_mix(b ^ w[1]) + a;
+		}
+
+		w[0] = w[1] = 0;
+		::memcpy(w, data + i, size - i);
+		a = hash_mix(a ^ w[0]) + b;
+		b = hash_mix(b ^ w[1]) + a;
+		return { hash_mix(a), hash_mix(b + a) };
+	}
+
+	// Line and column of an offset into the source code being reported
+	// Defined in Parser.cpp
+	Line_Col
+	location_line_col(uint32_t offset);
+
 	template<typename T>
 	struct Buf
 	{
@@ -127,8 +307,81 @@ namespace s22
 		inline const T &operator[](size_t i) const	{ return data[i]; }
 		inline T *begin()							{ return data; }
 		inline T *end()								{ return data + count; }
+		inline const T *begin() const				{ return data; }
+		inline const T *end() const					{ return data + count; }
 	};
 
+	// Append-only list in the arena, elements never move once pushed
+	// Chunks double in size starting from a few elements, so short lists stay cheap
+	template<typename T>
+	struct Arena_List
+	{
+		constexpr static uint32_t FIRST_CHUNK_CAP = 4;
+
+		struct Chunk
+		{
+			Chunk *next;
+			T *data;
+			uint32_t count;
+			uint32_t cap;
+		};
+
+		template<typename TElem>
+		struct Iterator
+		{
+			Chunk *chunk;
+			uint32_t i;
+
+			inline TElem &operator*() const { return chunk->data[i]; }
+			inline bool operator!=(const Iterator &other) const { return chunk != other.chunk || i != other.i; }
+			inline Iterator &
+			operator++()
+			{
+				if (++i == chunk->count && chunk->next)
+				{
+					chunk = chunk->next;
+					i = 0;
+				}
+				return *this;
+			}
+		};
+
+		Chunk *first;
+		Chunk *last;
+		size_t count;
+
+		inline T &back()								{ return last->data[last->count - 1]; }
+		inline Iterator<T> begin()						{ return { first, 0 }; }
+		inline Iterator<T> end()						{ return { last, last ? last->count : 0 }; }
+		inline Iterator<const T> begin() const			{ return { first, 0 }; }
+		inline Iterator<const T> end() const			{ return { last, last ? last->count : 0 }; }
+	};
+
+	template<typename T>
+	inline static T *
+	arena_list_push(Arena_List<T> &self, const T &value)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "arena memory is released without running destructors");
+
+		if (self.last == nullptr || self.last->count == self.last->cap)
+		{
+			auto chunk = alloc<typename Arena_List<T>::Chunk>();
+			chunk->cap = self.last ? self.last->cap * 2 : Arena_List<T>::FIRST_CHUNK_CAP;
+			chunk->data = (T *)arena_push(arena_instance(), chunk->cap * sizeof(T), alignof(T));
+
+			if (self.last)
+				self.last->next = chunk;
+			else
+				self.first = chunk;
+			self.last = chunk;
+		}
+
+		auto ptr = &self.last->data[self.last->count++];
+		*ptr = value;
+		self.count++;
+		return ptr;
+	}
+
 	struct String
 	{
 		constexpr static auto CAP = 256;
@@ -142,8 +395,9 @@ namespace s22
 			*this = {};
 			if (str != nullptr)
 			{
-				strcpy_s(this->data, str);
-				this->count = strlen(str);
+				// Longer strings are truncated, data stays null terminated
+				this->count = std::min(strlen(str), (size_t)CAP);
+				memcpy(this->data, str, this->count);
 			}
 		}
 
@@ -153,6 +407,74 @@ namespace s22
 		inline bool operator!=(const String &other) const	{ return !operator==(other); }
 	};
 
+	// Handle to an interned string, equal strings share the same handle
+	// 0 is reserved for the empty string
+	struct Str_Id
+	{
+		uint32_t idx;
+
+		inline explicit operator bool() const			{ return idx != 0; }
+		inline bool operator==(const Str_Id &other) const	{ return idx == other.idx; }
+		inline bool operator!=(const Str_Id &other) const	{ return !operator==(other); }
+	};
+
+	// Identifier/label table of the current compilation
+	// String data lives in the compilation's arena and is null-terminated
+	struct Str_Table
+	{
+		std::unordered_map<std::string_view, uint32_t> lookup;
+		std::vector<std::string_view> strings; // indexed by Str_Id::idx
+	};
+
+	// String table of the current compilation
+	// Defined in Parser.cpp
+	Str_Table *
+	str_table_instance();
+
+	inline static Str_Id
+	str_intern(Str_Table *self, std::string_view str)
+	{
+		if (self->strings.empty())
+		{
+			self->strings.emplace_back("");
+			self->lookup.emplace(self->strings.back(), 0);
+		}
+
+		if (auto it = self->lookup.find(str); it != self->lookup.end())
+			return Str_Id{ it->second };
+
+		auto data = alloc<char>(str.size() + 1);
+		::memcpy(data, str.data(), str.size());
+
+		Str_Id self_id = { (uint32_t)self->strings.size() };
+		auto &view = self->strings.emplace_back(data, str.size());
+		self->lookup.emplace(view, self_id.idx);
+		return self_id;
+	}
+
+	inline static Str_Id
+	str_intern(std::string_view str)
+	{
+		return str_intern(str_table_instance(), str);
+	}
+
+	inline static std::string_view
+	str_view(Str_Id id)
+	{
+		auto self = str_table_instance();
+		if (id.idx >= self->strings.size())
+			return "";
+		return self->strings[id.idx];
+	}
+
+	// Must accompany an arena reset, as string data lives in the arena
+	inline static void
+	str_table_clear(Str_Table *self)
+	{
+		self->lookup.clear();
+		self->strings.clear();
+	}
+
 	template <typename T>
 	struct Optional
 	{
@@ -182,27 +504,81 @@ namespace s22
 		inline const T&operator |(const T& other) const { return bool(*this) ? *data : other; }
 	};
 
+	enum ERROR_CODE : uint8_t
+	{
+		E_NONE,
+
+		// Generic
+		E_MESSAGE,					// {str}
+		E_COMPLETE,
+		E_COMPLETE_WITH_ERRORS,
+		E_FILE_READ,
+		E_FILE_TOO_LARGE,
+		E_LEXER_BUFFER,
+
+		// Syntax
+		E_SYNTAX,					// unexpected {str}, expected {str} or {str}...
+		E_LITERAL_TOO_LARGE,
+
+		// Semantic
+		E_UNDECLARED_IDENTIFIER,
+		E_UNINITIALIZED_IDENTIFIER,
+		E_UNUSED_IDENTIFIER,
+		E_DUPLICATE_IDENTIFIER,		// {loc} of the first declaration
+		E_TYPE_MISMATCH,
+		E_ASSIGNMENT_TO_CONSTANT,
+		E_NOT_WITHIN_FUNCTION,
+		E_INVALID_OPERAND,
+		E_INVALID_INDEX,
+		E_NOT_INDEXABLE,
+		E_NOT_CALLABLE,
+		E_INVALID_ARGUMENT_COUNT,
+		E_INVALID_ARGUMENT,
+		E_INVALID_TYPE,
+		E_INVALID_CASE,
+		E_DUPLICATE_CASE,
+		E_DUPLICATE_DEFAULT,
+	};
+
+	// Typed error argument, strings must outlive the error (literals, Bison symbol names)
+	union Error_Arg
+	{
+		uint64_t u64;
+		const char *str;
+		Source_Location loc;
+
+		Error_Arg() : loc({}) {}
+		Error_Arg(uint64_t v) : u64(v) {}
+		Error_Arg(const char *v) : str(v) {}
+		Error_Arg(Source_Location v) : loc(v) {}
+	};
+
 	// these utility constructs are heavily inspired by [mn: minimal container library on top of c-flavored c++](https://github.com/moustaphaSaad/mn)
+	// Errors only record a code and their arguments, the message is formatted when displayed
 	struct Error
 	{
-		String msg;
+		constexpr static auto ARGS_MAX = 6;
+
+		ERROR_CODE code;
+		uint8_t arg_count;
 		Source_Location loc;
+		Error_Arg args[ARGS_MAX];
 
-		// creates a new error with the given error message
+		// creates a new error with the given code and arguments
 		template<typename... TArgs>
-		explicit Error(std::string_view fmt, TArgs &&...args) : msg({}), loc({})				{ msg = std::vformat(fmt, std::make_format_args(std::forward<TArgs>(args)...)).c_str(); }
+		explicit Error(ERROR_CODE code, TArgs &&...args) : code(code), arg_count(sizeof...(TArgs)), loc(LOCATION_NONE), args{ Error_Arg(args)... }	{ static_assert(sizeof...(TArgs) <= ARGS_MAX); }
 		template<typename... TArgs>
-		Error(Source_Location loc, std::string_view fmt, TArgs &&...args) : msg({}), loc(loc)	{ msg = std::vformat(fmt, std::make_format_args(std::forward<TArgs>(args)...)).c_str(); }
+		Error(Source_Location loc, ERROR_CODE code, TArgs &&...args) : code(code), arg_count(sizeof...(TArgs)), loc(loc), args{ Error_Arg(args)... }	{ static_assert(sizeof...(TArgs) <= ARGS_MAX); }
 
-		Error(Source_Location loc, const Error &other) : msg(other.msg), loc(loc) {}		// Overwrite location
+		Error(Source_Location loc, const Error &other) : Error(other) { this->loc = loc; }		// Overwrite location
 
-		Error()                              = default;
+		Error() : code(E_NONE), arg_count(0), loc(LOCATION_NONE) {}
 		Error(const Error &other)            = default;
 		Error(Error &&other)                 = default;
 		Error& operator=(const Error &other) = default;
 		Error& operator=(Error &&other)      = default;
 
-		inline explicit operator bool() const	{ return msg.count != 0; }
+		inline explicit operator bool() const	{ return code != E_NONE; }
 		inline bool operator==(bool v) const	{ return bool(*this) == v; }
 		inline bool operator!=(bool v) const	{ return !operator==(v); }
 	};
@@ -211,7 +587,7 @@ namespace s22
 	err_backup_loc(const Error &err, Source_Location loc)
 	{
 		Error self = err;
-		if (self.loc == Source_Location{})
+		if (self.loc == LOCATION_NONE)
 			self.loc = loc;
 		return self;
 	}
@@ -285,7 +661,8 @@ struct std::formatter<s22::Source_Location> : std::formatter<std::string>
 	auto
 	format(s22::Source_Location loc, format_context &ctx)
 	{
-		return format_to(ctx.out(), "{},{}", loc.first_line, loc.first_column);
+		auto [line, column] = s22::location_line_col(loc.offset);
+		return format_to(ctx.out(), "{},{}", line, column);
 	}
 };
 
@@ -295,7 +672,53 @@ struct std::formatter<s22::Error> : std::formatter<std::string>
 	auto
 	format(const s22::Error &err, format_context &ctx)
 	{
-		return format_to(ctx.out(), "{}", err.msg);
+		using namespace s22;
+		const char *msg = nullptr;
+		switch (err.code)
+		{
+		case E_NONE:						return ctx.out();
+
+		case E_MESSAGE:						return format_to(ctx.out(), "{}", err.args[0].str);
+		case E_COMPLETE:					msg = "Complete!"; break;
+		case E_COMPLETE_WITH_ERRORS:		msg = "Complete with errors!"; break;
+		case E_FILE_READ:					msg = "cannot read file"; break;
+		case E_FILE_TOO_LARGE:				msg = "file too large; max file size is 4GB"; break;
+		case E_LEXER_BUFFER:				msg = "lexer buffer is nullptr"; break;
+
+		case E_SYNTAX: {
+			format_to(ctx.out(), "unexpected {}", err.args[0].str);
+			for (size_t i = 1; i < err.arg_count; i++)
+			{
+				if (i == 1)
+					format_to(ctx.out(), ", expected {}", err.args[i].str);
+				else
+					format_to(ctx.out(), " or {}", err.args[i].str);
+			}
+			return ctx.out();
+		}
+		case E_LITERAL_TOO_LARGE:			msg = "literal too large for its type"; break;
+
+		case E_UNDECLARED_IDENTIFIER:		msg = "undeclared identifier"; break;
+		case E_UNINITIALIZED_IDENTIFIER:	msg = "uninitialized identifier"; break;
+		case E_UNUSED_IDENTIFIER:			msg = "unused identifier"; break;
+		case E_DUPLICATE_IDENTIFIER:		return format_to(ctx.out(), "duplicate identifier at {}", err.args[0].loc);
+		case E_TYPE_MISMATCH:				msg = "type mismatch"; break;
+		case E_ASSIGNMENT_TO_CONSTANT:		msg = "assignment to constant"; break;
+		case E_NOT_WITHIN_FUNCTION:			msg = "not within a function"; break;
+		case E_INVALID_OPERAND:				msg = "invalid operand"; break;
+		case E_INVALID_INDEX:				msg = "invalid index"; break;
+		case E_NOT_INDEXABLE:				msg = "type cannot be indexed"; break;
+		case E_NOT_CALLABLE:				msg = "type is not callable"; break;
+		case E_INVALID_ARGUMENT_COUNT:		msg = "invalid argument count"; break;
+		case E_INVALID_ARGUMENT:			msg = "invalid argument"; break;
+		case E_INVALID_TYPE:				msg = "invalid type"; break;
+		case E_INVALID_CASE:				msg = "invalid case"; break;
+		case E_DUPLICATE_CASE:				msg = "duplicate case"; break;
+		case E_DUPLICATE_DEFAULT:			msg = "duplicate default"; break;
+
+		default: return ctx.out();
+		}
+		return format_to(ctx.out(), "{}", msg);
 	}
 };
 
@@ -343,6 +766,16 @@ struct std::formatter<s22::String> : std::formatter<std::string>
 	}
 };
 
+template <>
+struct std::formatter<s22::Str_Id> : std::formatter<std::string>
+{
+	auto
+	format(s22::Str_Id id, format_context &ctx)
+	{
+		return format_to(ctx.out(), "{}", s22::str_view(id));
+	}
+};
+
 template <typename T>
 struct std::formatter<s22::Optional<T>> : std::formatter<std::string>
 {
@@ -5,226 +5,200 @@
 
 namespace s22
 {
-	AST
-	ast_literal(Literal *literal)
+	template <typename T>
+	inline static AST
+	ast_push(std::vector<T> &nodes, AST::KIND kind, const T &node)
 	{
-		AST self = { .kind = AST::LITERAL };
-
-		auto &lit = self.as_lit;
-		lit = alloc<Literal>();
-		*lit = *literal;
-
+		AST self = { .kind = kind, .idx = (uint32_t)nodes.size() };
+		nodes.push_back(node);
 		return self;
 	}
 
 	AST
-	ast_symbol(Symbol *sym)
+	ast_literal(Literal literal)
 	{
-		AST self = { .kind = AST::SYMBOL };
-		self.as_sym = sym;
-		return self;
-	};
+		return ast_push(ast_pool_instance()->literals, AST::LITERAL, literal);
+	}
 
 	AST
-	ast_pcall(Symbol *sym, const Buf<AST> &args)
+	ast_symbol(Symbol *sym)
 	{
-		AST self = { .kind = AST::PROC_CALL };
-
-		auto &pcall = self.as_pcall;
-		pcall = alloc<Proc_Call>();
-		pcall->sym = sym;
-		pcall->args = args;
+		return ast_push(ast_pool_instance()->symbols, AST::SYMBOL, sym);
+	}
 
-		return self;
+	AST
+	ast_pcall(Symbol *sym, AST_Range args)
+	{
+		Proc_Call pcall = { .sym = sym, .args = args };
+		return ast_push(ast_pool_instance()->pcalls, AST::PROC_CALL, pcall);
 	}
 
 	AST
 	ast_array_access(Symbol *sym, AST index)
 	{
-		AST self = { .kind = AST::ARRAY_ACCESS };
-
-		auto &array = self.as_arr_access;
-		array = alloc<Array_Access>();
-		array->sym = sym;
-		array->index = index;
-
-		return self;
+		Array_Access array = { .sym = sym, .index = index };
+		return ast_push(ast_pool_instance()->arr_accesses, AST::ARRAY_ACCESS, array);
 	}
 
 	AST
-	ast_binary(Binary_Op::KIND kind, AST left, AST right)
+	ast_binary(Binary_Op::KIND kind, Semantic_Expr::BASE type, AST left, AST right)
 	{
-		AST self = { .kind = AST::BINARY };
-
-		auto &bin = self.as_binary;
-		bin = alloc<Binary_Op>();
-		bin->kind = kind;
-		bin->left = left;
-		bin->right = right;
-
-		return self;
+		Binary_Op bin = { .kind = kind, .type = type, .left = left, .right = right };
+		return ast_push(ast_pool_instance()->binaries, AST::BINARY, bin);
 	}
 
 	AST
-	ast_unary(Unary_Op::KIND kind, AST right)
+	ast_unary(Unary_Op::KIND kind, Semantic_Expr::BASE type, AST right)
 	{
-		AST self = { .kind = AST::UNARY };
-
-		auto &uny = self.as_unary;
-		uny = alloc<Unary_Op>();
-		uny->kind = kind;
-		uny->right = right;
-
-		return self;
+		Unary_Op uny = { .kind = kind, .type = type, .right = right };
+		return ast_push(ast_pool_instance()->unaries, AST::UNARY, uny);
 	}
 
 	AST
 	ast_assign(Assignment::KIND kind, AST dst, AST expr)
 	{
-		AST self = { .kind = AST::ASSIGN };
-
-		auto &assign = self.as_assign;
-		assign = alloc<Assignment>();
-		assign->kind = kind;
-		assign->dst = dst;
-		assign->expr = expr;
-
-		return self;
+		Assignment assign = { .kind = kind, .dst = dst, .expr = expr };
+		return ast_push(ast_pool_instance()->assigns, AST::ASSIGN, assign);
 	}
 
 	AST
 	ast_decl(Symbol *sym, AST expr)
 	{
-		AST self = { .kind = AST::DECL };
-
-		auto &decl = self.as_decl;
-		decl = alloc<Decl>();
-		decl->sym = sym;
-		decl->expr = expr;
-
-		return self;
+		Decl decl = { .sym = sym, .expr = expr };
+		return ast_push(ast_pool_instance()->decls, AST::DECL, decl);
 	}
 
 	AST
-	ast_decl_proc(Symbol *sym, const Buf<Decl *> &args, Block *block)
+	ast_decl_proc(Symbol *sym, AST_Range args, AST block)
 	{
-		AST self = { .kind = AST::DECL_PROC };
-
-		auto &decl = self.as_decl_proc;
-		decl = alloc<Decl_Proc>();
-		decl->sym = sym;
-		decl->args = args;
-		decl->block = block;
-
-		return self;
+		Decl_Proc decl = { .sym = sym, .args = args, .block = block };
+		return ast_push(ast_pool_instance()->decl_procs, AST::DECL_PROC, decl);
 	}
 
 	AST
-	ast_if(If_Condition *prev, AST cond, Block *block, If_Condition *next)
+	ast_if(AST prev, AST cond, AST block, AST next)
 	{
-		AST self = { .kind = AST::IF_COND };
-
-		auto &if_cond = self.as_if;
-		if_cond = alloc<If_Condition>();
-		if_cond->cond = cond;
-		if_cond->prev = prev;
-		if_cond->next = next;
-		if_cond->block = block;
-
-		return self;
+		If_Condition if_cond = { .cond = cond, .prev = prev, .next = next, .block = block };
+		return ast_push(ast_pool_instance()->ifs, AST::IF_COND, if_cond);
 	}
 
 	AST
-	ast_switch_case(AST expr, const Buf<Literal*> &group, Block *block)
+	ast_switch_case(AST expr, AST_Range group, AST block)
 	{
-		AST self = { .kind = AST::SWITCH_CASE };
-
-		auto &swc = self.as_case;
-		swc = alloc<Switch_Case>();
-		swc->expr = expr;
-		swc->group = group;
-		swc->block = block;
-
-		return self;
+		Switch_Case swc = { .expr = expr, .group = group, .block = block };
+		return ast_push(ast_pool_instance()->cases, AST::SWITCH_CASE, swc);
 	}
 
 	AST
-	ast_switch(const Buf<Switch_Case*> &cases, Block *case_default)
+	ast_switch(AST_Range cases, AST case_default)
 	{
-		AST self = { .kind = AST::SWITCH };
-
-		auto &sw = self.as_switch;
-		sw = alloc<Switch>();
-		sw->cases = cases;
-		sw->case_default = case_default;
-
-		return self;
+		Switch sw = { .cases = cases, .case_default = case_default };
+		return ast_push(ast_pool_instance()->switches, AST::SWITCH, sw);
 	}
 
 	AST
-	ast_while(AST cond, Block *block)
+	ast_while(AST cond, AST block)
 	{
-		AST self = { .kind = AST::WHILE };
-
-		auto &loop = self.as_while;
-		loop = alloc<While_Loop>();
-		loop->cond = cond;
-		loop->block = block;
-
-		return self;
+		While_Loop loop = { .cond = cond, .block = block };
+		return ast_push(ast_pool_instance()->whiles, AST::WHILE, loop);
 	}
 
 	AST
-	ast_do_while(AST cond, Block *block)
+	ast_do_while(AST cond, AST block)
 	{
-		AST self = { .kind = AST::DO_WHILE };
+		Do_While_Loop loop = { .cond = cond, .block = block };
+		return ast_push(ast_pool_instance()->do_whiles, AST::DO_WHILE, loop);
+	}
 
-		auto &loop = self.as_do_while;
-		loop = alloc<Do_While_Loop>();
-		loop->cond = cond;
-		loop->block = block;
+	AST
+	ast_for(AST init, AST cond, AST post, AST block)
+	{
+		For_Loop loop = { .init = init, .cond = cond, .post = post, .block = block };
+		return ast_push(ast_pool_instance()->fors, AST::FOR, loop);
+	}
 
-		return self;
+	AST
+	ast_block(AST_Range stmts, size_t used_stack_size)
+	{
+		Block block = { .stmts = stmts, .used_stack_size = used_stack_size };
+		return ast_push(ast_pool_instance()->blocks, AST::BLOCK, block);
 	}
 
 	AST
-	ast_for(AST init, AST cond, AST post, Block *block)
+	ast_return(AST expr, Symbol *sym)
 	{
-		AST self = { .kind = AST::FOR };
+		Return ret = { .expr = expr, .proc_sym = sym };
+		return ast_push(ast_pool_instance()->returns, AST::RETURN, ret);
+	}
 
-		auto &loop = self.as_for;
-		loop = alloc<For_Loop>();
-		loop->init = init;
-		loop->cond = cond;
-		loop->post = post;
-		loop->block = block;
+	AST_Range
+	ast_range_make(size_t count)
+	{
+		auto &children = ast_pool_instance()->children;
 
+		AST_Range self = { .first = (uint32_t)children.size(), .count = (uint32_t)count };
+		children.resize(children.size() + count);
 		return self;
 	}
 
-	AST
-	ast_block(const Buf<AST> &stmts, size_t used_stack_size)
+	AST_Range
+	ast_range_clone(const std::vector<AST> &nodes)
 	{
-		AST self = { .kind = AST::BLOCK };
-
-		auto &block = self.as_block;
-		block = alloc<Block>();
-		block->stmts = stmts;
-		block->used_stack_size = used_stack_size;
+		auto &children = ast_pool_instance()->children;
 
+		AST_Range self = { .first = (uint32_t)children.size(), .count = (uint32_t)nodes.size() };
+		children.insert(children.end(), nodes.begin(), nodes.end());
 		return self;
 	}
 
-	AST
-	ast_return(AST expr, Symbol *sym)
+	size_t
+	ast_pool_count(const AST_Pool *self, AST::KIND kind)
 	{
-		AST self = { .kind = AST::RETURN };
+		switch (kind)
+		{
+		case AST::LITERAL:		return self->literals.size();
+		case AST::SYMBOL:		return self->symbols.size();
+		case AST::PROC_CALL:	return self->pcalls.size();
+		case AST::ARRAY_ACCESS:	return self->arr_accesses.size();
+		case AST::BINARY:		return self->binaries.size();
+		case AST::UNARY:		return self->unaries.size();
+		case AST::ASSIGN:		return self->assigns.size();
+		case AST::DECL:			return self->decls.size();
+		case AST::DECL_PROC:	return self->decl_procs.size();
+		case AST::IF_COND:		return self->ifs.size();
+		case AST::SWITCH:		return self->switches.size();
+		case AST::SWITCH_CASE:	return self->cases.size();
+		case AST::WHILE:		return self->whiles.size();
+		case AST::DO_WHILE:		return self->do_whiles.size();
+		case AST::FOR:			return self->fors.size();
+		case AST::BLOCK:		return self->blocks.size();
+		case AST::RETURN:		return self->returns.size();
 
-		auto &ret = self.as_return;
-		ret = alloc<Return>();
-		ret->expr = expr;
-		ret->proc_sym = sym;
+		default:
+			return 0;
+		}
+	}
 
-		return self;
+	void
+	ast_pool_clear(AST_Pool *self)
+	{
+		self->literals.clear();
+		self->symbols.clear();
+		self->pcalls.clear();
+		self->arr_accesses.clear();
+		self->binaries.clear();
+		self->unaries.clear();
+		self->assigns.clear();
+		self->decls.clear();
+		self->decl_procs.clear();
+		self->ifs.clear();
+		self->switches.clear();
+		self->cases.clear();
+		self->whiles.clear();
+		self->do_whiles.clear();
+		self->fors.clear();
+		self->blocks.clear();
+		self->returns.clear();
+		self->children.clear();
 	}
 }
\ No newline at end of file
@@ -1,88 +1,11 @@
 #include "compiler/Backend.h"
 #include "compiler/Symbol.h"
 #include "compiler/Parser.h"
-
-#include <unordered_map>
+#include "compiler/SSA.h"
+#include "compiler/Peephole.h"
 
 namespace s22
 {
-	struct Label
-	{
-		enum TYPE
-		{
-			NONE,
-
-			LABEL,
-
-			OR_TRUE, END_OR,
-			AND_FALSE, END_AND,
-			NOT_TRUE, END_NOT,
-			COND_FALSE, END_COND,
-
-			END_IF, END_ELSEIF, END_ALL,
-			CASE, END_CASE, END_SWITCH,
-
-			FOR, END_FOR,
-			WHILE, END_WHILE,
-
-			PROC, END_PROC,
-		};
-		TYPE type;
-		uint64_t id; // used for standard labels
-		String text; // used for proc labels
-	};
-
-	// Temporary register
-	// Memory address
-	// Immediate value
-	// Condition
-	enum OPERAND_LOCATION
-	{
-		OP_NIL,				// NIL value
-		OP_TMP,				// intermediate value
-		OP_IMM,				// immediate value
-		OP_SYM,				// symbol
-		OP_LBL,				// label
-	};
-
-	struct Operand
-	{
-		OPERAND_LOCATION loc;
-
-		inline Operand() = default;
-		inline Operand(OPERAND_LOCATION l)		{ *this = {}; loc = l; }
-		inline Operand(int v)					{ *this = {}; loc = OP_IMM; value = (uint64_t)v; }
-		inline Operand(uint64_t v)				{ *this = {}; loc = OP_IMM; value = v; }
-		inline Operand(String s)				{ *this = {}; loc = OP_SYM; sym = s; }
-		inline Operand(Label lbl)				{ *this = {}; loc = OP_LBL; label = lbl; }
-
-		template<typename... TArgs>
-		inline explicit Operand(std::string_view fmt, TArgs &&...args)
-		{
-			*this = {};
-			loc = OP_SYM;
-			sym = std::vformat(fmt, std::make_format_args(std::forward<TArgs>(args)...)).c_str();
-		}
-
-		union // immediate value/memory offset
-		{
-			uint64_t value;
-			uint64_t tmp_label_suffix;
-			String sym;
-		};
-		Label label;	// set when loc is a label
-						// TODO: procedures carry both their label and their address here, change this
-	};
-
-	struct Instruction
-	{
-		INSTRUCTION_OP op;
-		Operand dst, src1, src2;
-		
-		size_t operand_count;
-		Label label;// adds a label to the instruction
-	};
-
 	inline static bool
 	op_is_logical(INSTRUCTION_OP op)
 	{
@@ -124,12 +47,30 @@ namespace s22
 		}
 	}
 
+	// Comparison setting a 0 or 1 result instead of branching
+	inline static INSTRUCTION_OP
+	op_set(INSTRUCTION_OP op)
+	{
+		switch (op)
+		{
+		case I_LOG_LT: return I_SLT;
+		case I_LOG_LEQ: return I_SLE;
+		case I_LOG_EQ: return I_SEQ;
+		case I_LOG_NEQ: return I_SNE;
+		case I_LOG_GT: return I_SGT;
+		case I_LOG_GEQ: return I_SGE;
+
+		default:
+			s22_unreachable_msg("unrecognized op");
+			return I_SEQ;
+		}
+	}
+
 	struct IBackend
 	{
-		std::unordered_map<const Symbol *, Operand> variables; // maps symbol to memory locations
-															   // also maps procs to their labels/locations
-		std::vector<Instruction> program;
-		size_t label_counter;
+		Program program;
+		AST_Pool *asts;			// nodes of the AST being compiled
+		uint32_t label_counter;
 		size_t temp_counter;
 	};
 
@@ -139,14 +80,25 @@ namespace s22
 	{
 		Instruction ins = { op, Operand{std::forward<TArgs>(args)}... };
 		ins.operand_count = sizeof...(args);
-		self->program.push_back(ins);
+		program_push(self->program, ins);
+	}
+
+	// Instruction whose operands are values of the given type, folding them needs to know it
+	template <typename... TArgs>
+	inline static void
+	be_typed_instruction(Backend self, Semantic_Expr::BASE type, INSTRUCTION_OP op, TArgs &&...args)
+	{
+		Instruction ins = { op, Operand{std::forward<TArgs>(args)}... };
+		ins.operand_count = sizeof...(args);
+		ins.type = type;
+		program_push(self->program, ins);
 	}
 
 	inline static void
 	be_label(Backend self, Label label)
 	{
 		Instruction ins = { .label = label };
-		self->program.push_back(ins);
+		program_push(self->program, ins);
 	}
 
 	template <typename... TArgs>
@@ -156,10 +108,10 @@ namespace s22
 		Instruction ins = { op, {std::forward<TArgs>(args)}... };
 		ins.operand_count = sizeof...(args);
 		ins.label = label;
-		self->program.push_back(ins);
+		program_push(self->program, ins);
 	}
 
-	inline static size_t
+	inline static uint32_t
 	be_new_label_id(Backend self)
 	{
 		return self->label_counter++;
@@ -174,186 +126,164 @@ namespace s22
 	inline static void
 	be_logical_and(Backend self, Instruction ins)
 	{
-		auto label_id = be_new_label_id(self);
-		Label end_if  = { .type = Label::AND_FALSE, .id = label_id };
-		Label end_all = { .type = Label::END_AND,   .id = label_id };
-
-		// bz $end_if, op1
-		// bz $end_if, op2
-		be_instruction(self, I_BZ, end_if, ins.src1);
-		be_instruction(self, I_BZ, end_if, ins.src2);
-
-		// mov dst, 1
-		be_instruction(self, I_MOV, ins.dst, 1);
-
-		// br $end
-		be_instruction(self, I_BR, end_all);
-
-		// $end_if: mov dst, 0
-		be_label_with_instruction(self, end_if, I_MOV, ins.dst, 0);
-
-		// $end_all:
-		be_label(self, end_all);
+		// land dst, op1, op2
+		be_typed_instruction(self, Semantic_Expr::BOOL, I_LAND, ins.dst, ins.src1, ins.src2);
 	}
 
 	inline static void
 	be_logical_or(Backend self, Instruction ins)
 	{
-		// a = b || c
-		// a = !(!b && !c)
-		auto label_id = be_new_label_id(self);
-		Label end_if  = { .type = Label::OR_TRUE, .id = label_id };
-		Label end_all = { .type = Label::END_OR,  .id = label_id };
-
-		// bnz $end_if, op1
-		// bnz $end_if, op2
-		be_instruction(self, I_BNZ, end_if, ins.src1);
-		be_instruction(self, I_BNZ, end_if, ins.src2);
-
-		// mov dst, 0
-		be_instruction(self, I_MOV, ins.dst, 0);
-
-		// br $end
-		be_instruction(self, I_BR, end_all);
-
-		// $end_if: mov dst, 1
-		be_label_with_instruction(self, end_if, I_MOV, ins.dst, 1);
-
-		// $end_all:
-		be_label(self, end_all);
+		// lor dst, op1, op2
+		be_typed_instruction(self, Semantic_Expr::BOOL, I_LOR, ins.dst, ins.src1, ins.src2);
 	}
 
 	inline static void
 	be_logical_not(Backend self, Instruction ins)
 	{
-		auto label_id = be_new_label_id(self);
-		Label end_if  = { .type = Label::NOT_TRUE, .id = label_id };
-		Label end_all = { .type = Label::END_NOT,  .id = label_id };
-
-		// bz $end_if, op
-		be_instruction(self, I_BZ, end_if, ins.src1);
-
-		// mov dst, 1
-		be_instruction(self, I_MOV, ins.dst, 1);
-
-		// br $end
-		be_instruction(self, I_BR, end_all);
-
-		// $end_if: mov dst, 0
-		be_label_with_instruction(self, end_if, I_MOV, ins.dst, 0);
-
-		// $end_all:
-		be_label(self, end_all);
+		// seq dst, op, 0
+		auto type = (Semantic_Expr::BASE)ins.type;
+		be_typed_instruction(self, type == Semantic_Expr::FLOAT ? type : Semantic_Expr::UINT, I_SEQ, ins.dst, ins.src1, 0);
 	}
 
 	inline static void
 	be_compare(Backend self, Instruction ins)
 	{
-		auto label_id = be_new_label_id(self);
-		Label end_if  = { .type = Label::COND_FALSE, .id = label_id };
-		Label end_all = { .type = Label::END_COND, 	 .id = label_id };
-
-		// b_inv $end_if, op1, op2
-		be_instruction(self, op_invert(ins.op), end_if, ins.src1, ins.src2);
-
-		// mov dst, 1
-		be_instruction(self, I_MOV, ins.dst, 1);
-
-		// br $end
-		be_instruction(self, I_BR, end_all);
-
-		// $end_if: mov dst, 0
-		be_label_with_instruction(self, end_if, I_MOV, ins.dst, 0);
-
-		// $end_all:
-		be_label(self, end_all);
+		// s_op dst, op1, op2
+		be_typed_instruction(self, (Semantic_Expr::BASE)ins.type, op_set(ins.op), ins.dst, ins.src1, ins.src2);
 	}
 
 	inline static void
-	be_assign(Backend self, INSTRUCTION_OP op, Operand left, Operand right)
+	be_assign(Backend self, INSTRUCTION_OP op, Semantic_Expr::BASE type, Operand left, Operand right)
 	{
 		if (op == I_MOV)
 			be_instruction(self, op, left, right);
 		else
-			be_instruction(self, op, left, left, right);
+			be_typed_instruction(self, type, op, left, left, right);
 		
 		be_clear_temps(self);
 	}
 
-	inline static void
-	be_decl(Backend self, const Symbol *sym)
+	inline static Operand
+	be_generate(Backend self, AST ast);
+
+	inline static Operand
+	be_temp(Backend self)
 	{
-		self->variables[sym] = {sym->id};
+		Operand opr = {};
+		opr.loc = OP_TMP;
+		opr.tmp_label_suffix = self->temp_counter++;
+		return opr;
 	}
 
-	inline static void
-	be_decl_expr(Backend self, const Symbol *sym, Operand right)
+	inline static Operand
+	be_literal(Backend self, const Literal *lit)
 	{
-		be_decl(self, sym);
-		be_assign(self, I_MOV, self->variables[sym], right);
+		Operand opr = {lit->value};
+		return opr;
 	}
 
-	inline static void
-	be_decl_proc(Backend self, Decl_Proc *proc, Label proc_lbl)
+	// Variables are addressed by their symbol, procedures by their label
+	inline static Operand
+	be_sym(Backend self, const Symbol *sym)
 	{
-		self->variables[proc->sym] = {proc_lbl};
+		if (semexpr_procedure(sym->type) != nullptr)
+			return Label{ .type = Label::PROC, .text = sym->id };
 
-		if (proc->sym->type.procedure->return_type != SEMEXPR_VOID)
-		{
-			self->variables[proc->sym].sym = std::format("t${}", proc->sym->id).c_str();
-		}
+		return sym->id;
+	}
 
-		// Add arguments
-		for (const auto &arg : proc->args)
-		{
-			be_decl(self, arg->sym);
-		}
+	inline static void
+	be_decl_expr(Backend self, const Symbol *sym, Operand right)
+	{
+		be_assign(self, I_MOV, Semantic_Expr::VOID, be_sym(self, sym), right);
 	}
 
-	Operand
-	be_generate(Backend self, AST ast);
+	// Procedure parameter slot, proc$i
+	inline static Operand
+	be_proc_param(const Symbol *proc_sym, size_t i)
+	{
+		Operand opr = {OP_PARAM};
+		opr.sym = proc_sym->id;
+		opr.value = i;
+		return opr;
+	}
 
+	// Procedure return slot, t$proc
 	inline static Operand
-	be_temp(Backend self)
+	be_proc_ret(const Symbol *proc_sym)
 	{
-		Operand opr = {};
-		opr.loc = OP_TMP;
-		opr.tmp_label_suffix = self->temp_counter++;
+		Operand opr = {OP_RET};
+		opr.sym = proc_sym->id;
 		return opr;
 	}
 
 	inline static Operand
-	be_literal(Backend self, Literal *lit)
+	be_array_access(Backend self, const Array_Access *arr)
 	{
-		Operand opr = {lit->value};
+		auto index = be_generate(self, arr->index);
+
+		// Element indices are limited to a single value, nested accesses and slots go through a temporary
+		if (index.loc != OP_TMP && index.loc != OP_IMM && index.loc != OP_SYM)
+		{
+			auto tmp = be_temp(self);
+			be_instruction(self, I_MOV, tmp, index);
+			index = tmp;
+		}
+
+		Operand opr = {OP_ELEM};
+		opr.index_loc = index.loc;
+		opr.sym = arr->sym->id;
+		opr.value = index.loc == OP_SYM ? index.sym.idx : index.value;
 		return opr;
 	}
 
+	// Immediates only come from literals, which are never negative, not even -0.0, so any type of them is true when not 0
 	inline static Operand
-	be_sym(Backend self, const Symbol *sym)
+	be_truth_imm(Operand opr)
+	{
+		return opr.value != 0 ? 1 : 0;
+	}
+
+	// Set dst to the value of an operand of the given type as a boolean, 0 or 1, which booleans already are
+	// Literals yield VOID from be_type, their truth is known here
+	inline static void
+	be_set_truth(Backend self, Semantic_Expr::BASE type, Operand dst, Operand opr)
 	{
-		return self->variables[sym];
+		if (opr.loc == OP_IMM)
+			be_instruction(self, I_MOV, dst, be_truth_imm(opr));
+		else if (type == Semantic_Expr::BOOL)
+			be_instruction(self, I_MOV, dst, opr);
+		else // sne dst, opr, 0
+			be_typed_instruction(self, type == Semantic_Expr::FLOAT ? type : Semantic_Expr::UINT, I_SNE, dst, opr, 0);
 	}
 
 	inline static Operand
-	be_array_access(Backend self, const Array_Access *arr)
+	be_truth(Backend self, Semantic_Expr::BASE type, Operand opr)
 	{
-		return Operand{"{}({})", be_generate(self, arr->index), be_sym(self, arr->sym)};
+		if (opr.loc == OP_IMM)
+			return be_truth_imm(opr);
+
+		if (type == Semantic_Expr::BOOL)
+			return opr;
+
+		auto dst = be_temp(self);
+		be_set_truth(self, type, dst, opr);
+		return dst;
 	}
 
 	inline static Operand
-	be_binary(Backend self, INSTRUCTION_OP op, Operand left, Operand right)
+	be_binary(Backend self, INSTRUCTION_OP op, Semantic_Expr::BASE type, Operand left, Operand right)
 	{
 		// Collect operands
 		auto dst = be_temp(self);
 		if (op_is_logical(op) == false)
 		{
-			be_instruction(self, op, dst, left, right);
+			be_typed_instruction(self, type, op, dst, left, right);
 		}
 		else
 		{
 			// Logical operations as intermediate boolean result, dst is set to either 0 or 1
-			Instruction ins = {.op = op, .dst = dst, .src1 = left, .src2 = right};
+			Instruction ins = {.op = op, .dst = dst, .src1 = left, .src2 = right, .type = type};
 			if (op == I_LOG_AND)		be_logical_and(self, ins);
 			else if (op == I_LOG_OR)	be_logical_or(self, ins);
 			else						be_compare(self, ins);
@@ -363,17 +293,17 @@ namespace s22
 	}
 	
 	inline static Operand
-	be_unary(Backend self, INSTRUCTION_OP op, Operand right)
+	be_unary(Backend self, INSTRUCTION_OP op, Semantic_Expr::BASE type, Operand right)
 	{
 		auto dst = be_temp(self);
 		if (op_is_logical(op) == false)
 		{
-			be_instruction(self, op, dst, right);
+			be_typed_instruction(self, type, op, dst, right);
 		}
 		else
 		{
 			// Logical operations as intermediate boolean result, dst is set to either 0 or 1
-			Instruction ins = {.op = I_LOG_NOT, .dst = dst, .src1 = right};
+			Instruction ins = {.op = I_LOG_NOT, .dst = dst, .src1 = right, .type = type};
 			be_logical_not(self, ins);
 		}
 
@@ -381,31 +311,108 @@ namespace s22
 	}
 
 	inline static Operand
-	be_proc_call(Backend self, Proc_Call *pcall)
+	be_proc_call(Backend self, const Proc_Call *pcall)
 	{
 		int offset = 0;
-		auto &proc = *pcall->sym->type.procedure;
+		auto &proc = *semexpr_procedure(pcall->sym->type);
+		auto args = ast_children(pcall->args, self->asts);
 		
 		for (size_t i = 0; i < proc.parameters.count; i++)
 		{
-			auto src = be_generate(self, pcall->args[i]);
-			auto dst = Operand{"{}${}", be_sym(self, pcall->sym), i};
-			be_assign(self, I_MOV, dst, src);
+			auto src = be_generate(self, args[i]);
+			auto dst = be_proc_param(pcall->sym, i);
+			be_assign(self, I_MOV, Semantic_Expr::VOID, dst, src);
 		}
 		
 		be_instruction(self, I_CALL, be_sym(self, pcall->sym));
 		if (proc.return_type != SEMEXPR_VOID)
 		{
-			return Operand{"t${}", be_sym(self, pcall->sym)};
+			return be_proc_ret(pcall->sym);
 		}
 		
 		return {};
 	}
 
+	// Base type of the value of an expression, literals do not keep theirs and yield VOID
+	inline static Semantic_Expr::BASE
+	be_type(Backend self, AST ast)
+	{
+		switch (ast.kind)
+		{
+		case AST::SYMBOL: return semexpr_base(ast.as_sym(self->asts)->type);
+		case AST::ARRAY_ACCESS: return semexpr_base(ast.as_arr_access(self->asts)->sym->type);
+		case AST::PROC_CALL: return semexpr_base(semexpr_procedure(ast.as_pcall(self->asts)->sym->type)->return_type);
+		case AST::BINARY: {
+			auto bin = ast.as_binary(self->asts);
+			return op_is_logical((INSTRUCTION_OP)bin->kind) ? Semantic_Expr::BOOL : bin->type;
+		}
+		case AST::UNARY: {
+			auto uny = ast.as_unary(self->asts);
+			return op_is_logical((INSTRUCTION_OP)uny->kind) ? Semantic_Expr::BOOL : uny->type;
+		}
+		default: return Semantic_Expr::VOID;
+		}
+	}
+
+	// Whether an expression can be evaluated when its value ends up unused, it has no effects and cannot trap
+	inline static bool
+	be_can_speculate(Backend self, AST ast)
+	{
+		switch (ast.kind)
+		{
+		case AST::LITERAL:
+		case AST::SYMBOL:
+			return true;
+
+		case AST::BINARY: {
+			auto bin = ast.as_binary(self->asts);
+			switch ((INSTRUCTION_OP)bin->kind)
+			{
+			case I_DIV: case I_MOD: case I_SHL: case I_SHR:
+				return false;
+			default:
+				return be_can_speculate(self, bin->left) && be_can_speculate(self, bin->right);
+			}
+		}
+
+		case AST::UNARY:
+			return be_can_speculate(self, ast.as_unary(self->asts)->right);
+
+		default:
+			return false;
+		}
+	}
+
+	// a && b, a || b evaluating b only if a does not decide the result
+	inline static Operand
+	be_short_circuit(Backend self, const Binary_Op *bin)
+	{
+		auto op = (INSTRUCTION_OP)bin->kind;
+		Label end_all = { .type = op == I_LOG_AND ? Label::END_AND : Label::END_OR, .id = be_new_label_id(self) };
+
+		// dst = bool(op1), a boolean temporary is the result already
+		// bz $end, dst (bnz for ||)
+		auto dst = be_generate(self, bin->left);
+		if (dst.loc != OP_TMP || bin->type != Semantic_Expr::BOOL)
+		{
+			auto left = dst;
+			dst = be_temp(self);
+			be_set_truth(self, bin->type, dst, left);
+		}
+		be_instruction(self, op == I_LOG_AND ? I_BZ : I_BNZ, end_all, dst);
+
+		// dst = bool(op2)
+		be_set_truth(self, be_type(self, bin->right), dst, be_generate(self, bin->right));
+
+		// $end_all:
+		be_label(self, end_all);
+		return dst;
+	}
+
 	inline static void
-	be_block(Backend self, Block *blk)
+	be_block(Backend self, AST ast)
 	{
-		for (auto stmt : blk->stmts)
+		for (auto stmt : ast_children(ast.as_block(self->asts)->stmts, self->asts))
 			be_generate(self, stmt);
 	}
 
@@ -427,7 +434,7 @@ namespace s22
 		}
 
 		case AST::BINARY: {
-			auto bin = ast.as_binary;
+			auto bin = ast.as_binary(self->asts);
 			auto op = (INSTRUCTION_OP)bin->kind;
 
 			// cond != 0
@@ -443,7 +450,8 @@ namespace s22
 			}
 			else if (op == I_LOG_OR)
 			{
-				Label lbl_true = {.type = Label::OR_TRUE, .id = branch_to.id};
+				// Nested conditions share branch_to, labels of their own keep every label defined once
+				Label lbl_true = {.type = Label::OR_TRUE, .id = be_new_label_id(self)};
 
 				Label left_is_false = {.type = Label::COND_FALSE, .id = be_new_label_id(self)};
 				be_branch_if_false(self, bin->left, left_is_false);
@@ -460,13 +468,13 @@ namespace s22
 				auto left = be_generate(self, bin->left);
 				auto right = be_generate(self, bin->right);
 
-				be_instruction(self, op_invert(op), branch_to, left, right);
+				be_typed_instruction(self, bin->type, op_invert(op), branch_to, left, right);
 			}
 			break;
 		}
 
 		case AST::UNARY: {
-			auto uny = ast.as_unary;
+			auto uny = ast.as_unary(self->asts);
 			auto op = (INSTRUCTION_OP)uny->kind;
 
 			// cond != 0
@@ -477,7 +485,7 @@ namespace s22
 			}
 			else// NOT
 			{
-				Label lbl_true = {.type = Label::NOT_TRUE, .id = branch_to.id};
+				Label lbl_true = {.type = Label::NOT_TRUE, .id = be_new_label_id(self)};
 				be_branch_if_false(self, uny->right, lbl_true);
 				be_instruction(self, I_BR, branch_to);
 
@@ -487,16 +495,17 @@ namespace s22
 		}
 
 		case AST::SWITCH_CASE: {
-			auto swc = ast.as_case;
+			auto swc = ast.as_case(self->asts);
 
 			// Fetch the expression
+			auto type = be_type(self, swc->expr);
 			auto expr = be_generate(self, swc->expr);
 
 			// Go to true if any value matches
 			Label lbl_true = {.type = Label::CASE, .id = branch_to.id};
-			for (auto lit : swc->group)
+			for (auto lit : ast_children(swc->group, self->asts))
 			{
-				be_instruction(self, I_LOG_EQ, lbl_true, expr, be_literal(self, lit));
+				be_typed_instruction(self, type, I_LOG_EQ, lbl_true, expr, be_literal(self, lit.as_lit(self->asts)));
 			}
 
 			be_instruction(self, I_BR, branch_to);
@@ -514,40 +523,50 @@ namespace s22
 	{
 		switch (ast.kind)
 		{
-		case AST::LITERAL: return be_literal(self, ast.as_lit);
-		case AST::SYMBOL: return be_sym(self, ast.as_sym);
-		case AST::PROC_CALL: return be_proc_call(self, ast.as_pcall);
-		case AST::ARRAY_ACCESS: return be_array_access(self, ast.as_arr_access);
+		case AST::LITERAL: return be_literal(self, ast.as_lit(self->asts));
+		case AST::SYMBOL: return be_sym(self, ast.as_sym(self->asts));
+		case AST::PROC_CALL: return be_proc_call(self, ast.as_pcall(self->asts));
+		case AST::ARRAY_ACCESS: return be_array_access(self, ast.as_arr_access(self->asts));
 
 		case AST::BINARY: {
-			auto bin = ast.as_binary;
+			auto bin = ast.as_binary(self->asts);
+			auto op = (INSTRUCTION_OP)bin->kind;
+
+			// The right operand of a logical operator runs only when needed, unless running it anyway is harmless
+			if ((op == I_LOG_AND || op == I_LOG_OR) && be_can_speculate(self, bin->right) == false)
+				return be_short_circuit(self, bin);
+
 			auto left = be_generate(self, bin->left);
 			auto right = be_generate(self, bin->right);
-			return be_binary(self, (INSTRUCTION_OP)bin->kind, left, right);
+
+			// Logical operators work on booleans, their operands are cast to one
+			if (op == I_LOG_AND || op == I_LOG_OR)
+			{
+				left = be_truth(self, bin->type, left);
+				right = be_truth(self, be_type(self, bin->right), right);
+			}
+			return be_binary(self, op, bin->type, left, right);
 		}
 
 		case AST::UNARY: {
-			auto uny = ast.as_unary;
+			auto uny = ast.as_unary(self->asts);
 			auto right = be_generate(self, uny->right);
-			return be_unary(self, (INSTRUCTION_OP)uny->kind, right);
+			return be_unary(self, (INSTRUCTION_OP)uny->kind, uny->type, right);
 		}
 
 		case AST::ASSIGN: {
-			auto as = ast.as_assign;
+			auto as = ast.as_assign(self->asts);
 			auto dst = be_generate(self, as->dst);
 			auto expr = be_generate(self, as->expr);
-			be_assign(self, (INSTRUCTION_OP)as->kind, dst, expr);
+			be_assign(self, (INSTRUCTION_OP)as->kind, be_type(self, as->dst), dst, expr);
 			return {};
 		}
 
 		case AST::DECL: {
-			auto decl = ast.as_decl;
+			auto decl = ast.as_decl(self->asts);
 
-			if (decl->expr.kind == AST::NIL)
-			{
-				be_decl(self, decl->sym);
-			}
-			else
+			// Uninitialized declarations emit nothing
+			if (decl->expr.kind != AST::NIL)
 			{
 				auto expr = be_generate(self, decl->expr);
 				be_decl_expr(self, decl->sym, expr);
@@ -557,12 +576,10 @@ namespace s22
 		}
 
 		case AST::DECL_PROC: {
-			auto proc = ast.as_decl_proc;
+			auto proc = ast.as_decl_proc(self->asts);
 
 			Label proc_lbl = {.type = Label::PROC, .text = proc->sym->id};
 			be_label(self, proc_lbl);
-
-			be_decl_proc(self, proc, proc_lbl);
 			
 			be_block(self, proc->block);
 			
@@ -575,8 +592,9 @@ namespace s22
 		case AST::IF_COND: {
 			Label end_all = {.type = Label::END_ALL, .id = be_new_label_id(self)};
 
-			for (auto ifc = ast.as_if; ifc != nullptr; ifc = ifc->next)
+			for (auto next = ast; next.kind != AST::NIL; next = next.as_if(self->asts)->next)
 			{
+				auto ifc = next.as_if(self->asts);
 				Label end_if = {.type = Label::END_IF, .id = be_new_label_id(self)};
 				be_branch_if_false(self, ifc->cond, end_if);
 				be_clear_temps(self);
@@ -594,22 +612,21 @@ namespace s22
 		case AST::SWITCH: {
 			Label end_switch = {.type = Label::END_SWITCH, .id = be_new_label_id(self)};
 
-			auto sw = ast.as_switch;
+			auto sw = ast.as_switch(self->asts);
 
-			for (auto &swc : sw->cases)
+			for (auto swc : ast_children(sw->cases, self->asts))
 			{
 				Label end_case = {.type = Label::END_CASE, .id = be_new_label_id(self)};
-				AST case_ast = {.kind = AST::SWITCH_CASE, .as_case = swc};
-				be_branch_if_false(self, case_ast, end_case);
+				be_branch_if_false(self, swc, end_case);
 				be_clear_temps(self);
 
-				be_block(self, swc->block);
+				be_block(self, swc.as_case(self->asts)->block);
 
 				be_instruction(self, I_BR, end_switch);
 				be_label(self, end_case);
 			}
 
-			if (sw->case_default)
+			if (sw->case_default.kind != AST::NIL)
 				be_block(self, sw->case_default);
 
 			be_label(self, end_switch);
@@ -617,7 +634,7 @@ namespace s22
 		}
 
 		case AST::WHILE: {
-			auto wh = ast.as_while;
+			auto wh = ast.as_while(self->asts);
 
 			Label begin_while = {.type = Label::WHILE, .id = be_new_label_id(self)};
 			Label end_while = {.type = Label::END_WHILE, .id = begin_while.id};
@@ -636,7 +653,7 @@ namespace s22
 		}
 
 		case AST::DO_WHILE: {
-			auto do_wh = ast.as_do_while;
+			auto do_wh = ast.as_do_while(self->asts);
 
 			Label begin_do_while = {.type = Label::WHILE, .id = be_new_label_id(self)};
 			Label end_do_while = {.type = Label::END_WHILE, .id = begin_do_while.id};
@@ -655,7 +672,7 @@ namespace s22
 		}
 
 		case AST::FOR: {
-			auto loop = ast.as_for;
+			auto loop = ast.as_for(self->asts);
 
 			Label begin_for = {.type = Label::FOR, .id = be_new_label_id(self)};
 			Label end_for = {.type = Label::END_FOR, .id = begin_for.id};
@@ -681,17 +698,17 @@ namespace s22
 		}
 
 		case AST::BLOCK: {
-			be_block(self, ast.as_block);
+			be_block(self, ast);
 			return {};
 		}
 
 		case AST::RETURN: {
-			auto &ret = ast.as_return;
+			auto ret = ast.as_return(self->asts);
 
-			if (auto return_type = ret->proc_sym->type.procedure->return_type; return_type != SEMEXPR_VOID)
+			if (auto return_type = semexpr_procedure(ret->proc_sym->type)->return_type; return_type != SEMEXPR_VOID)
 			{
 				auto expr = be_generate(self, ret->expr);
-				be_assign(self, I_MOV, self->variables[ret->proc_sym].sym, expr);
+				be_assign(self, I_MOV, Semantic_Expr::VOID, be_proc_ret(ret->proc_sym), expr);
 			}
 
 			Label return_lbl = {.type = Label::END_PROC, .text = ret->proc_sym->id};
@@ -706,10 +723,15 @@ namespace s22
 	}
 
 	Backend
-	backend_instance()
+	backend_new()
 	{
-		static IBackend self = {};
-		return &self;
+		return new IBackend{};
+	}
+
+	void
+	backend_free(Backend self)
+	{
+		delete self;
 	}
 
 	void
@@ -718,18 +740,31 @@ namespace s22
 		if (self == nullptr)
 			return;
 
-		self->variables.clear();
-		self->program.clear();
+		program_clear(self->program);
+		self->asts = nullptr;
 		self->label_counter = 0;
 		self->temp_counter = 0;
 	}
 
+	size_t
+	backend_optimize(Backend self)
+	{
+		return ssa_optimize(self->program);
+	}
+
+	size_t
+	backend_peephole(Backend self)
+	{
+		return peephole_optimize(self->program);
+	}
+
 	UI_Program
 	backend_get_ui_program(Backend self)
 	{
 		UI_Program program = {};
-		for (const auto &ins : self->program)
+		for (size_t i = 0; i < self->program.count(); i++)
 		{
+			auto ins = program_get(self->program, i);
 			auto &line = program.emplace_back();
 
 			if (ins.label.type != s22::Label::NONE)
@@ -753,142 +788,29 @@ namespace s22
 	}
 
 	void
-	backend_compile(Backend self, AST ast)
+	backend_write(Backend self, std::string &out)
 	{
-		// Start root stack frame at 0
-		be_block(self, ast.as_block);
-	}
-}
-
-template <>
-struct std::formatter<s22::Operand> : std::formatter<std::string>
-{
-	auto
-	format(s22::Operand opr, format_context &ctx)
-	{
-		using namespace s22;
-		switch (opr.loc)
-		{
-		case OP_NIL: return ctx.out();
-		case OP_TMP: return format_to(ctx.out(), "t{}", opr.tmp_label_suffix);
-		case OP_IMM: return format_to(ctx.out(), "{}", opr.value);
-		case OP_SYM: return format_to(ctx.out(), "{}", opr.sym);
-		case OP_LBL: return format_to(ctx.out(), "{}", opr.label);
-		default: return ctx.out();
-		}
+		for (size_t i = 0; i < self->program.count(); i++)
+			std::format_to(std::back_inserter(out), "{}\n", program_get(self->program, i));
 	}
-};
 
-template <>
-struct std::formatter<s22::Label> : std::formatter<std::string>
-{
-	auto
-	format(s22::Label label, format_context &ctx)
+	size_t
+	backend_instruction_count(Backend self)
 	{
-		using namespace s22;
-
-		const char *lbl = nullptr;
-		switch (label.type)
-		{
-		case Label::LABEL: 		lbl = "LABEL"; 		break;
-
-		case Label::OR_TRUE: 	lbl = "OR_TRUE"; 	break;
-		case Label::END_OR: 	lbl = "END_OR"; 	break;
-
-		case Label::AND_FALSE: 	lbl = "AND_FALSE"; 	break;
-		case Label::END_AND: 	lbl = "END_AND"; 	break;
-
-		case Label::NOT_TRUE: 	lbl = "NOT_TRUE"; 	break;
-		case Label::END_NOT: 	lbl = "END_NOT"; 	break;
-
-		case Label::COND_FALSE: lbl = "COND_FALSE"; break;
-		case Label::END_COND: 	lbl = "END_COND"; 	break;
-
-		case Label::END_IF: 	lbl = "END_IF";		break;
-		case Label::END_ELSEIF: lbl = "END_ELSEIF";	break;
-		case Label::END_ALL: 	lbl = "END_ALL";	break;
-
-		case Label::CASE: 		lbl = "CASE";		break;
-		case Label::END_CASE: 	lbl = "END_CASE";	break;
-		case Label::END_SWITCH: lbl = "END_SWITCH";	break;
-
-		case Label::FOR: 		lbl = "FOR";		break;
-		case Label::END_FOR: 	lbl = "END_FOR";	break;
-
-		case Label::WHILE: 		lbl = "WHILE";		break;
-		case Label::END_WHILE: 	lbl = "END_WHILE";	break;
-
-		case Label::PROC:		return format_to(ctx.out(), "{}", label.text);
-		case Label::END_PROC:	return format_to(ctx.out(), "{}$end", label.text);
-
-		default: return ctx.out();
-		}
-		return format_to(ctx.out(), "{}${}", lbl, label.id);
+		return self->program.count();
 	}
-};
 
-template <>
-struct std::formatter<s22::INSTRUCTION_OP> : std::formatter<std::string>
-{
-	auto
-	format(s22::INSTRUCTION_OP op, format_context &ctx)
+	const Program &
+	backend_program(Backend self)
 	{
-		using namespace s22;
-		switch (op)
-		{
-		case I_NOP: return ctx.out();
-		case I_MOV: return format_to(ctx.out(), "=");
-
-		// Arithmetic
-		case I_ADD: return format_to(ctx.out(), "+");
-		case I_SUB: return format_to(ctx.out(), "-");
-		case I_MUL: return format_to(ctx.out(), "*");
-		case I_DIV: return format_to(ctx.out(), "/");
-		case I_MOD: return format_to(ctx.out(), "%");
-		case I_AND: return format_to(ctx.out(), "&");
-		case I_OR:	return format_to(ctx.out(), "|");
-		case I_XOR: return format_to(ctx.out(), "^");
-		case I_SHL: return format_to(ctx.out(), "<<");
-		case I_SHR: return format_to(ctx.out(), ">>");
-		case I_NEG: return format_to(ctx.out(), "neg");
-		case I_INV: return format_to(ctx.out(), "~");
-
-		// Logical
-		case I_LOG_LT:	return format_to(ctx.out(), "BLT");
-		case I_LOG_LEQ: return format_to(ctx.out(), "BLE");
-		case I_LOG_EQ:	return format_to(ctx.out(), "BEQ");
-		case I_LOG_NEQ: return format_to(ctx.out(), "BNE");
-		case I_LOG_GEQ: return format_to(ctx.out(), "BGE");
-		case I_LOG_GT:	return format_to(ctx.out(), "BGT");
-
-		// Branch
-		case I_BR:	return format_to(ctx.out(), "BR");
-		case I_BZ:	return format_to(ctx.out(), "BZ");
-		case I_BNZ: return format_to(ctx.out(), "BNZ");
-
-		// Procedures
-		case I_CALL: return format_to(ctx.out(), "CALL");
-		case I_RET:  return format_to(ctx.out(), "RET");
-		
-		default: return ctx.out();
-		}
+		return self->program;
 	}
-};
 
-template <>
-struct std::formatter<s22::Instruction> : std::formatter<std::string>
-{
-	auto
-	format(s22::Instruction ins, format_context &ctx)
+	void
+	backend_compile(Backend self, AST ast)
 	{
-		if (ins.label.type != s22::Label::NONE)
-			format_to(ctx.out(), "{}: ", ins.label);
-
-		format_to(ctx.out(), "{}", ins.op);
-		if (ins.operand_count >= 1) format_to(ctx.out(), " {}", ins.dst);
-		if (ins.operand_count >= 2) format_to(ctx.out(), ", {}", ins.src1);
-		if (ins.operand_count == 3) format_to(ctx.out(), ", {}", ins.src2);
-
-		return ctx.out();
+		// Start root stack frame at 0
+		self->asts = ast_pool_instance();
+		be_block(self, ast);
 	}
-};
\ No newline at end of file
+}
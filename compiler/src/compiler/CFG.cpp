@@ -0,0 +1,428 @@
+#include "compiler/CFG.h"
+
+namespace s22
+{
+	void
+	label_index_build(Label_Index &self, const Program &program)
+	{
+		size_t count = 0;
+		for (auto label : program.labels)
+			count += label.type != Label::NONE;
+
+		size_t cap = 16;
+		while (cap < count * 2)
+			cap *= 2;
+		self.slots.assign(cap, {});
+
+		for (uint32_t i = 0; i < program.count(); i++)
+		{
+			auto label = program.labels[i];
+			if (label.type == Label::NONE)
+				continue;
+
+			auto key = label_key(label);
+			auto s = label_slot(key, cap);
+			while (self.slots[s].key != 0 && self.slots[s].key != key)
+				s = (s + 1) & (cap - 1);
+
+			// Procedures declared in different scopes may share a name, calls resolve to the first one
+			s22_assert_msg(self.slots[s].key == 0 || label.type == Label::PROC || label.type == Label::END_PROC, "label defined twice");
+			if (self.slots[s].key == 0)
+				self.slots[s] = { key, i };
+		}
+	}
+
+	inline static bool
+	cfg_reachable(const CFG &self, uint32_t b)
+	{
+		return self.blocks[b].dom_begin < self.blocks[b].dom_end;
+	}
+
+	// Predecessor lists from the successors
+	inline static void
+	cfg_link_preds(CFG &self)
+	{
+		for (auto &block : self.blocks)
+		{
+			for (auto s : block.succs)
+			{
+				if (s != CFG_NONE)
+					self.blocks[s].pred_count++;
+			}
+		}
+
+		uint32_t offset = 0;
+		for (auto &block : self.blocks)
+		{
+			block.preds = offset;
+			offset += block.pred_count;
+			block.pred_count = 0;
+		}
+
+		self.preds.resize(offset);
+		for (uint32_t b = 0; b < self.blocks.size(); b++)
+		{
+			for (auto s : self.blocks[b].succs)
+			{
+				if (s != CFG_NONE)
+				{
+					auto &succ = self.blocks[s];
+					self.preds[succ.preds + succ.pred_count++] = b;
+				}
+			}
+		}
+	}
+
+	// Dominators with the Semi-NCA algorithm over a depth-first spanning tree, also fills the reverse postorder
+	inline static void
+	cfg_dominators(CFG &self)
+	{
+		auto &blocks = self.blocks;
+
+		// Depth first search from the entry, vertices are numbered in preorder
+		std::vector<uint32_t> number(blocks.size(), CFG_NONE);
+		std::vector<uint32_t> vertex, parent;
+
+		struct Frame
+		{
+			uint32_t block;
+			uint32_t succ;	// next successor to visit
+		};
+		std::vector<Frame> stack = { { 0, 0 } };
+		number[0] = 0;
+		vertex.push_back(0);
+		parent.push_back(0);
+		while (stack.empty() == false)
+		{
+			auto &frame = stack.back();
+			if (frame.succ == 2)
+			{
+				self.order.push_back(frame.block);
+				stack.pop_back();
+				continue;
+			}
+
+			auto s = blocks[frame.block].succs[frame.succ++];
+			if (s == CFG_NONE || number[s] != CFG_NONE)
+				continue;
+
+			number[s] = (uint32_t)vertex.size();
+			vertex.push_back(s);
+			parent.push_back(number[frame.block]);
+			stack.push_back({ s, 0 });
+		}
+		std::reverse(self.order.begin(), self.order.end());
+
+		// Semidominators, vertices numbered above the one being processed are linked to their parents
+		auto count = (uint32_t)vertex.size();
+		std::vector<uint32_t> semi(count), label(count), ancestor = parent, idom = parent;
+		for (uint32_t v = 0; v < count; v++)
+			semi[v] = label[v] = v;
+
+		// Vertex of smallest semidominator on the linked path above v, compressing the path on the way
+		std::vector<uint32_t> path;
+		auto eval = [&](uint32_t v, uint32_t last_linked) {
+			if (ancestor[v] < last_linked)
+				return label[v];
+
+			auto x = v;
+			do
+			{
+				path.push_back(x);
+				x = ancestor[x];
+			} while (ancestor[x] >= last_linked);
+
+			auto x_label = label[x];
+			while (path.empty() == false)
+			{
+				auto y = path.back();
+				path.pop_back();
+
+				ancestor[y] = ancestor[x];
+				if (semi[x_label] < semi[label[y]])
+					label[y] = x_label;
+				else
+					x_label = label[y];
+				x = y;
+			}
+			return label[v];
+		};
+
+		for (auto w = count; w-- > 1;)
+		{
+			semi[w] = parent[w];
+			auto &block = blocks[vertex[w]];
+			for (uint32_t j = 0; j < block.pred_count; j++)
+			{
+				auto v = number[self.preds[block.preds + j]];
+				if (v != CFG_NONE)
+					semi[w] = std::min(semi[w], semi[eval(v, w + 1)]);
+			}
+		}
+
+		// Immediate dominator, the nearest common ancestor of the semidominator and the parent
+		for (uint32_t w = 1; w < count; w++)
+		{
+			auto d = idom[w];
+			while (d > semi[w])
+				d = idom[d];
+			idom[w] = d;
+			blocks[vertex[w]].idom = vertex[d];
+		}
+
+		// Dominator tree intervals, dominators come first in preorder so their intervals are placed before their children
+		std::vector<uint32_t> size(count, 1), next(count);
+		for (auto w = count; w-- > 1;)
+			size[idom[w]] += size[w];
+
+		blocks[0].dom_begin = 0;
+		blocks[0].dom_end = size[0];
+		next[0] = 1;
+		for (uint32_t w = 1; w < count; w++)
+		{
+			auto begin = next[idom[w]];
+			next[idom[w]] += size[w];
+			next[w] = begin + 1;
+
+			auto &block = blocks[vertex[w]];
+			block.dom_begin = begin;
+			block.dom_end = begin + size[w];
+		}
+	}
+
+	// Natural loops, from the innermost out, headers are visited in postorder so inner loops are found first
+	inline static void
+	cfg_loops(CFG &self)
+	{
+		auto &blocks = self.blocks;
+		std::vector<uint32_t> work;
+		for (auto k = self.order.size(); k-- > 0;)
+		{
+			auto h = self.order[k];
+			auto &header = blocks[h];
+			for (uint32_t j = 0; j < header.pred_count; j++)
+			{
+				if (auto p = self.preds[header.preds + j]; cfg_dominates(self, h, p))
+					work.push_back(p);
+			}
+
+			if (work.empty())
+				continue;
+
+			auto l = (uint32_t)self.loops.size();
+			self.loops.push_back({ .header = h, .parent = CFG_NONE, .depth = 0 }); // depth is set once all loops are found
+			header.loop = l;
+
+			// Walk back from the back edges to the header
+			while (work.empty() == false)
+			{
+				auto b = work.back();
+				work.pop_back();
+
+				auto inner = blocks[b].loop;
+				if (inner == CFG_NONE)
+				{
+					blocks[b].loop = l;
+					for (uint32_t j = 0; j < blocks[b].pred_count; j++)
+					{
+						if (auto p = self.preds[blocks[b].preds + j]; cfg_reachable(self, p))
+							work.push_back(p);
+					}
+					continue;
+				}
+
+				// Part of an inner loop, continue from the entries of its outermost loop found so far
+				while (self.loops[inner].parent != CFG_NONE)
+					inner = self.loops[inner].parent;
+				if (inner == l)
+					continue;
+
+				self.loops[inner].parent = l;
+				auto inner_h = self.loops[inner].header;
+				for (uint32_t j = 0; j < blocks[inner_h].pred_count; j++)
+				{
+					auto p = self.preds[blocks[inner_h].preds + j];
+					if (cfg_reachable(self, p) && cfg_dominates(self, inner_h, p) == false)
+						work.push_back(p);
+				}
+			}
+		}
+
+		// Enclosing loops are found after the loops they contain
+		for (auto l = self.loops.size(); l-- > 0;)
+		{
+			auto &loop = self.loops[l];
+			loop.depth = loop.parent == CFG_NONE ? 1 : self.loops[loop.parent].depth + 1;
+		}
+	}
+
+	void
+	cfg_build(Program_CFG &self, const Program &program)
+	{
+		auto count = (uint32_t)program.count();
+		self.procs.clear();
+		self.targets.assign(count, CFG_NONE);
+
+		Label_Index index = {};
+		label_index_build(index, program);
+
+		// Branch targets start blocks, so does the return of each procedure
+		std::vector<uint8_t> leader(count, 0);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (program.labels[i].type == Label::END_PROC)
+				leader[i] = true;
+
+			auto op = program.ops[i].op;
+			auto dst = program.operands[3 * i];
+			if ((op_is_branch(op) == false && op != I_CALL) || dst.loc != OP_LBL)
+				continue;
+
+			// Returns are resolved against the procedure containing them, as procedures may share a name
+			if (dst.label.type == Label::END_PROC)
+				continue;
+
+			self.targets[i] = label_index_find(index, dst.label);
+			if (op != I_CALL && self.targets[i] != CFG_NONE)
+				leader[self.targets[i]] = true;
+		}
+
+		// Procedures being emitted, innermost last
+		struct Open_Proc
+		{
+			uint32_t cfg;
+			uint32_t block;		// block being filled, CFG_NONE between blocks
+			uint32_t falls;		// block falling through into the next block of the procedure, CFG_NONE if none
+			size_t returns;		// first of the procedure's returns
+		};
+		std::vector<Open_Proc> open = { { 0, CFG_NONE, CFG_NONE, 0 } };
+		std::vector<uint32_t> returns;
+		std::vector<uint32_t> block_of(count, CFG_NONE); // block starting at each instruction
+
+		self.procs.emplace_back();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto label = program.labels[i];
+			if (label.type == Label::PROC)
+			{
+				open.push_back({ (uint32_t)self.procs.size(), CFG_NONE, CFG_NONE, returns.size() });
+				self.procs.emplace_back().proc = label.text;
+			}
+
+			auto &proc = open.back();
+			auto &cfg = self.procs[proc.cfg];
+			if (proc.block == CFG_NONE)
+			{
+				proc.block = (uint32_t)cfg.blocks.size();
+				block_of[i] = proc.block;
+				cfg.blocks.push_back({
+					.begin = i,
+					.end = i,
+					.succs = { CFG_NONE, CFG_NONE },
+					.preds = 0,
+					.pred_count = 0,
+					.idom = CFG_NONE,
+					.dom_begin = 0,
+					.dom_end = 0,
+					.loop = CFG_NONE,
+				});
+
+				if (proc.falls != CFG_NONE)
+					cfg.blocks[proc.falls].succs[1] = proc.block;
+				proc.falls = CFG_NONE;
+			}
+
+			auto op = program.ops[i].op;
+			auto dst = program.operands[3 * i];
+			if (op_is_branch(op) && dst.loc == OP_LBL && dst.label.type == Label::END_PROC)
+				returns.push_back(i);
+
+			bool ends_proc = label.type == Label::END_PROC && open.size() > 1;
+			bool ends_block = ends_proc || op_is_branch(op) || op == I_RET ||
+				i + 1 == count || leader[i + 1] || program.labels[i + 1].type == Label::PROC;
+			if (ends_block == false)
+				continue;
+
+			cfg.blocks[proc.block].end = i + 1;
+			proc.falls = op == I_BR || op == I_RET ? CFG_NONE : proc.block;
+			proc.block = CFG_NONE;
+
+			if (ends_proc)
+			{
+				for (auto j = proc.returns; j < returns.size(); j++)
+					self.targets[returns[j]] = i;
+				returns.resize(proc.returns);
+				open.pop_back();
+			}
+		}
+
+		for (auto &cfg : self.procs)
+		{
+			// Branch edges, targets always start a block of the same procedure
+			for (auto &block : cfg.blocks)
+			{
+				auto last = block.end - 1;
+				if (op_is_branch(program.ops[last].op) && self.targets[last] != CFG_NONE)
+					block.succs[0] = block_of[self.targets[last]];
+				if (block.succs[0] == block.succs[1])
+					block.succs[1] = CFG_NONE;
+			}
+
+			if (cfg.blocks.empty())
+				continue;
+
+			cfg_link_preds(cfg);
+			cfg_dominators(cfg);
+			cfg_loops(cfg);
+		}
+	}
+
+	void
+	cfg_write(const Program_CFG &self, const Program &program, std::string &out)
+	{
+		auto out_it = std::back_inserter(out);
+		auto block_name = [](uint32_t b) { return b == CFG_NONE ? std::string{"-"} : std::format("B{}", b); };
+
+		for (auto &cfg : self.procs)
+		{
+			if (cfg.proc)
+				std::format_to(out_it, "proc {}: {} blocks, {} loops\n", cfg.proc, cfg.blocks.size(), cfg.loops.size());
+			else
+				std::format_to(out_it, "global: {} blocks, {} loops\n", cfg.blocks.size(), cfg.loops.size());
+
+			for (uint32_t b = 0; b < cfg.blocks.size(); b++)
+			{
+				auto &block = cfg.blocks[b];
+				std::format_to(out_it, "B{} [{}, {}) preds", b, block.begin, block.end);
+				for (uint32_t j = 0; j < block.pred_count; j++)
+					std::format_to(out_it, " B{}", cfg.preds[block.preds + j]);
+
+				out += " succs";
+				for (auto s : block.succs)
+				{
+					if (s != CFG_NONE)
+						std::format_to(out_it, " B{}", s);
+				}
+
+				std::format_to(out_it, " idom {}", block_name(block.idom));
+				if (block.loop != CFG_NONE)
+					std::format_to(out_it, " loop L{}", block.loop);
+				if (cfg_reachable(cfg, b) == false)
+					out += " unreachable";
+				out += "\n";
+
+				for (auto i = block.begin; i < block.end; i++)
+					std::format_to(out_it, "\t{}\n", program_get(program, i));
+			}
+
+			for (uint32_t l = 0; l < cfg.loops.size(); l++)
+			{
+				auto &loop = cfg.loops[l];
+				std::format_to(out_it, "L{} header B{} depth {}", l, loop.header, loop.depth);
+				if (loop.parent != CFG_NONE)
+					std::format_to(out_it, " parent L{}", loop.parent);
+				out += "\n";
+			}
+		}
+	}
+}
@@ -0,0 +1,339 @@
+#include "compiler/Parser.h"
+#include "Parser.hpp" // Token definitions
+
+#include <array>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define LEXER_SSE2 1
+#else
+	#define LEXER_SSE2 0
+#endif
+
+// Hand-written counterpart of Lexer.l, every rule there has a matching case here
+// Runs of blanks, digits and identifier characters are scanned 16 bytes at a time, comments are skipped with memchr
+namespace s22
+{
+	enum LEXER_CLASS : uint8_t
+	{
+		LEXER_INVALID,	// no rule matches
+		LEXER_BLANK,	// [ \t]
+		LEXER_NEWLINE,
+		LEXER_ALPHA,	// [_a-zA-Z]
+		LEXER_DIGIT,
+		LEXER_PUNCT,	// operators and punctuation
+	};
+
+	constexpr auto LEXER_CLASSES = [] {
+		std::array<uint8_t, 256> self = {};
+		for (int c = 0; c < 256; c++)
+		{
+			if (c == ' ' || c == '\t')
+				self[c] = LEXER_BLANK;
+			else if (c == '\n')
+				self[c] = LEXER_NEWLINE;
+			else if (c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+				self[c] = LEXER_ALPHA;
+			else if (c >= '0' && c <= '9')
+				self[c] = LEXER_DIGIT;
+		}
+		for (auto c : std::string_view{";:{},()[]<>+-*/%&|=^!~"})
+			self[(uint8_t)c] = LEXER_PUNCT;
+		return self;
+	}();
+
+	inline static uint8_t
+	lexer_class(char c)
+	{
+		return LEXER_CLASSES[(uint8_t)c];
+	}
+
+	struct Lexer_Keyword
+	{
+		std::string_view text;
+		int kind;
+	};
+
+	// Keywords are 2 to 7 characters, length, first and last character tell them apart
+	constexpr size_t LEXER_KEYWORD_MIN = 2;
+	constexpr size_t LEXER_KEYWORD_MAX = 7;
+
+	constexpr size_t
+	lexer_keyword_hash(const char *text, size_t size)
+	{
+		return (size * 6 + (uint8_t)text[0] + (uint8_t)text[size - 1] * 20) & 31;
+	}
+
+	// Perfect hash table, a collision fails the build
+	constexpr auto LEXER_KEYWORDS = [] {
+		Lexer_Keyword keywords[] = {
+			{"const", CONST}, {"if", IF}, {"else", ELSE}, {"while", WHILE}, {"do", DO}, {"for", FOR},
+			{"switch", SWITCH}, {"case", CASE}, {"default", DEFAULT}, {"proc", PROC}, {"return", RETURN},
+			{"true", TRUE}, {"false", FALSE}, {"int", INT}, {"uint", UINT}, {"float", FLOAT}, {"bool", BOOL},
+		};
+
+		std::array<Lexer_Keyword, 32> self = {};
+		for (auto keyword : keywords)
+		{
+			auto &slot = self[lexer_keyword_hash(keyword.text.data(), keyword.text.size())];
+			if (slot.kind != 0)
+				throw "keyword hash collision";
+			slot = keyword;
+		}
+		return self;
+	}();
+
+	inline static int
+	lexer_keyword(const char *text, size_t size)
+	{
+		if (size < LEXER_KEYWORD_MIN || size > LEXER_KEYWORD_MAX)
+			return IDENTIFIER;
+
+		auto &keyword = LEXER_KEYWORDS[lexer_keyword_hash(text, size)];
+		if (keyword.text.size() != size || ::memcmp(keyword.text.data(), text, size) != 0)
+			return IDENTIFIER;
+		return keyword.kind;
+	}
+
+#if LEXER_SSE2
+	// Bytes in [lo, hi], signed compares only so the range is moved to start at -128
+	inline static __m128i
+	simd_in_range(__m128i c, char lo, char hi)
+	{
+		auto moved = _mm_add_epi8(c, _mm_set1_epi8((char)(-128 - lo)));
+		return _mm_cmplt_epi8(moved, _mm_set1_epi8((char)(-128 + (hi - lo) + 1)));
+	}
+
+	// Index of the first byte outside the class, 16 if all of them are in it
+	inline static int
+	simd_first_outside(__m128i in)
+	{
+		return std::countr_zero((uint32_t)_mm_movemask_epi8(in) ^ 0x1FFFF);
+	}
+#endif
+
+	// First byte from p on that is not a blank
+	inline static const char *
+	lexer_skip_blanks(const char *p, const char *end)
+	{
+	#if LEXER_SSE2
+		for (; end - p >= 16; p += 16)
+		{
+			auto c = _mm_loadu_si128((const __m128i *)p);
+			auto in = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\t')));
+			if (auto i = simd_first_outside(in); i < 16)
+				return p + i;
+		}
+	#endif
+		while (p < end && lexer_class(*p) == LEXER_BLANK)
+			p++;
+		return p;
+	}
+
+	// First byte from p on that is not a digit
+	inline static const char *
+	lexer_skip_digits(const char *p, const char *end)
+	{
+	#if LEXER_SSE2
+		for (; end - p >= 16; p += 16)
+		{
+			auto c = _mm_loadu_si128((const __m128i *)p);
+			if (auto i = simd_first_outside(simd_in_range(c, '0', '9')); i < 16)
+				return p + i;
+		}
+	#endif
+		while (p < end && lexer_class(*p) == LEXER_DIGIT)
+			p++;
+		return p;
+	}
+
+	// First byte from p on that cannot continue an identifier
+	inline static const char *
+	lexer_skip_identifier(const char *p, const char *end)
+	{
+	#if LEXER_SSE2
+		for (; end - p >= 16; p += 16)
+		{
+			auto c = _mm_loadu_si128((const __m128i *)p);
+			auto lower = _mm_or_si128(c, _mm_set1_epi8(0x20)); // only letters land in [a-z]
+			auto in = _mm_or_si128(
+				_mm_or_si128(simd_in_range(lower, 'a', 'z'), simd_in_range(c, '0', '9')),
+				_mm_cmpeq_epi8(c, _mm_set1_epi8('_'))
+			);
+			if (auto i = simd_first_outside(in); i < 16)
+				return p + i;
+		}
+	#endif
+		while (p < end && (lexer_class(*p) == LEXER_ALPHA || lexer_class(*p) == LEXER_DIGIT))
+			p++;
+		return p;
+	}
+
+	// Operator or punctuation starting at p, returns its kind and sets its size
+	inline static int
+	lexer_punct(const char *p, const char *end, size_t &size)
+	{
+		auto next = [&](size_t i) { return p + i < end ? p[i] : '\0'; };
+
+		size = 2;
+		switch (p[0])
+		{
+		case '<':
+			if (next(1) == '<')
+			{
+				if (next(2) == '=')
+				{
+					size = 3;
+					return AS_SHL;
+				}
+				return SHL;
+			}
+			if (next(1) == '=') return LEQ;
+			break;
+		case '>':
+			if (next(1) == '>')
+			{
+				if (next(2) == '=')
+				{
+					size = 3;
+					return AS_SHR;
+				}
+				return SHR;
+			}
+			if (next(1) == '=') return GEQ;
+			break;
+		case ':':
+			if (next(1) == ':') return DBL_COLON;
+			break;
+		case '-':
+			if (next(1) == '>') return ARROW;
+			if (next(1) == '=') return AS_SUB;
+			break;
+		case '&':
+			if (next(1) == '&') return L_AND;
+			if (next(1) == '=') return AS_AND;
+			break;
+		case '|':
+			if (next(1) == '|') return L_OR;
+			if (next(1) == '=') return AS_OR;
+			break;
+		case '=':
+			if (next(1) == '=') return EQ;
+			break;
+		case '!':
+			if (next(1) == '=') return NEQ;
+			break;
+		case '+':
+			if (next(1) == '=') return AS_ADD;
+			break;
+		case '*':
+			if (next(1) == '=') return AS_MUL;
+			break;
+		case '/':
+			if (next(1) == '=') return AS_DIV;
+			break;
+		case '%':
+			if (next(1) == '=') return AS_MOD;
+			break;
+		case '^':
+			if (next(1) == '=') return AS_XOR;
+			break;
+		}
+
+		size = 1;
+		return (uint8_t)p[0];
+	}
+
+	void
+	lexer_simd_tokenize(const char *code, size_t size, uint32_t base, Token_Stream &tokens, Source_Location &end)
+	{
+		auto p = code, stop = code + size;
+
+		// Location of the last lexeme that is not a line break, like the scanner's yylloc
+		Source_Location last = {};
+		auto lexeme = [&](const char *start) {
+			last = { base + (uint32_t)(start - code), (uint32_t)(p - start) };
+			return last;
+		};
+
+		while (p < stop)
+		{
+			auto start = p;
+			switch (lexer_class(*p))
+			{
+			case LEXER_NEWLINE:
+				// Line breaks keep the previous location
+				p++;
+				break;
+
+			case LEXER_BLANK:
+				p = lexer_skip_blanks(p + 1, stop);
+				lexeme(start);
+				break;
+
+			case LEXER_ALPHA:
+			{
+				p = lexer_skip_identifier(p + 1, stop);
+				auto kind = lexer_keyword(start, p - start);
+				token_stream_push(tokens, kind, lexeme(start), kind == TRUE ? 1 : 0); // true and false carry their value
+				break;
+			}
+
+			case LEXER_DIGIT:
+			{
+				int kind = LIT_INT;
+				p = lexer_skip_digits(p + 1, stop);
+				if (stop - p >= 2 && p[0] == '.' && lexer_class(p[1]) == LEXER_DIGIT)
+				{
+					kind = LIT_FLOAT;
+					p = lexer_skip_digits(p + 2, stop);
+				}
+				else if (p < stop && p[0] == 'u')
+				{
+					kind = LIT_UINT;
+					p++;
+				}
+				Literal value = {};
+				if (literal_parse({ start, (size_t)(p - start) }, value) == false)
+					kind = TOKEN_OVERFLOW;
+				token_stream_push(tokens, kind, lexeme(start), value.value);
+				break;
+			}
+
+			case LEXER_PUNCT:
+			{
+				// Line comment, the line break ending it belongs to the same lexeme
+				if (p[0] == '/' && p + 1 < stop && p[1] == '/')
+				{
+					auto nl = (const char *)::memchr(p + 2, '\n', stop - p - 2);
+					if (nl == nullptr)
+					{
+						p = stop;
+						lexeme(start);
+					}
+					else
+					{
+						p = nl + 1;
+					}
+					break;
+				}
+
+				size_t len = 0;
+				auto kind = lexer_punct(p, stop, len);
+				p += len;
+				token_stream_push(tokens, kind, lexeme(start), 0);
+				break;
+			}
+
+			default:
+				p++;
+				token_stream_push(tokens, TOKEN_INVALID, lexeme(start), 0);
+				break;
+			}
+		}
+
+		if (last.length != 0)
+			end = last;
+	}
+}
@@ -2,16 +2,14 @@
 
 #include "compiler/Parser.h"
 
-// Bison variables
-extern int yylineno;
-extern int yycolno;
-extern int yyleng;
-extern char *yytext;
+// Defined in the generated parser
+int
+yyparse(s22::Parser *p);
 
 namespace s22
 {
 	inline static Parser::Context&
-	ctx_push(std::stack<Parser::Context> &ctx)
+	ctx_push(Parser::Context_Stack &ctx)
 	{
 		if (ctx.empty())
 			return ctx.emplace();
@@ -28,10 +26,11 @@ namespace s22
 		return inner_ctx;
 	}
 
-	inline static Parser::Context
-	ctx_pop(std::stack<Parser::Context> &ctx)
+	// The popped frame stays valid until the next push
+	inline static Parser::Context&
+	ctx_pop(Parser::Context_Stack &ctx)
 	{
-		auto inner_ctx = std::move(ctx.top());
+		auto &inner_ctx = ctx.top();
 		ctx.pop();
 		scope_pop(inner_ctx.scope);
 
@@ -46,7 +45,7 @@ namespace s22
 	}
 
 	inline static Parser::Context&
-	ctx_push_no_scope(std::stack<Parser::Context> &ctx)
+	ctx_push_no_scope(Parser::Context_Stack &ctx)
 	{
 		if (ctx.empty())
 			return ctx.emplace();
@@ -58,10 +57,10 @@ namespace s22
 		return inner_ctx;
 	}
 
-	inline static Parser::Context
-	ctx_pop_no_scope(std::stack<Parser::Context> &ctx)
+	inline static Parser::Context&
+	ctx_pop_no_scope(Parser::Context_Stack &ctx)
 	{
-		auto inner_ctx = std::move(ctx.top());
+		auto &inner_ctx = ctx.top();
 		ctx.pop();
 		return inner_ctx;
 	}
@@ -70,7 +69,8 @@ namespace s22
 	Parser::program_begin()
 	{
 		// Start instance
-		this->backend = backend_instance();
+		if (this->backend == nullptr)
+			this->backend = backend_new();
 
 		// Begin global context
 		auto &ctx = ctx_push(this->context);
@@ -81,26 +81,37 @@ namespace s22
 	Parser::program_end()
 	{
 		// End context
-		auto ctx = ctx_pop(this->context);
+		auto &ctx = ctx_pop(this->context);
 
 		// Program blocks
-		auto ast = ast_block(Buf<AST>::view(ctx.block_stmts));
-		ast.as_block->used_stack_size = ctx.stack_offset;
+		auto ast = ast_block(ast_range_clone(ctx.block_stmts), ctx.stack_offset);
 
 		if (this->has_errors)
 		{
-			parser_log(Error{ "Complete with errors!" }, Log_Level::INFO);
+			parser_log(Error{ E_COMPLETE_WITH_ERRORS }, Log_Level::INFO);
 		}
 		else
 		{
-			parser_log(Error{ "Complete!" }, Log_Level::INFO);
-			backend_compile(this->backend, ast);
+			parser_log(Error{ E_COMPLETE }, Log_Level::INFO);
+
+			{
+				Phase_Timer timer = { this->stats.codegen };
+				backend_compile(this->backend, ast);
+			}
+
+			if (this->unoptimized == false)
+			{
+				Phase_Timer timer = { this->stats.optimize };
+				this->stats.quadruples_removed = backend_optimize(this->backend);
+				this->stats.peephole_removed = backend_peephole(this->backend);
+			}
 		}
 	}
 
 	UI_Program
 	Parser::program_write()
 	{
+		Phase_Timer timer = { this->stats.emit };
 		return backend_get_ui_program(this->backend);
 	}
 
@@ -110,10 +121,19 @@ namespace s22
 		this->has_errors = false;
 		backend_dispose(this->backend);
 		this->global = {};
-		this->context = {};
-
-		auto mem = Memory_Log::instance();
-		mem->free_all();
+		this->context.count = 0; // frames are kept for the next compilation
+
+		str_table_clear(&this->strings);
+		type_table_clear(&this->types);
+		ast_pool_clear(&this->asts);
+		this->diagnostics.clear();
+		this->log_source_taken = false;
+		this->source = {};
+		this->token_next = 0;
+		this->token_names.clear();
+		this->stats = {};
+		this->source_lines.starts.clear();
+		arena_reset(&this->arena);
 	}
 
 	Semantic_Expr
@@ -129,8 +149,7 @@ namespace s22
 			return self;
 		}
 
-		self = type_base;
-		self.array = literal.ast.as_lit->value;
+		self = semexpr_array_of(semexpr_base(type_base), literal.ast.as_lit()->value);
 
 		return self;
 	}
@@ -155,12 +174,10 @@ namespace s22
 		Parse_Unit self = {};
 
 		// End context
-		auto ctx = ctx_pop(this->context);
+		auto &ctx = ctx_pop(this->context);
 
 		// Build block from statements found in the context
-		auto stmts = Buf<AST>::clone(ctx.block_stmts);
-		self.ast = ast_block(stmts);
-		self.ast.as_block->used_stack_size = ctx.stack_offset;
+		self.ast = ast_block(ast_range_clone(ctx.block_stmts), ctx.stack_offset);
 
 		return self;
 	}
@@ -173,8 +190,8 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [proc_sym, err] = scope_return_matches_proc_sym(ctx.scope, SEMEXPR_VOID); err)
 		{
-			self.err = err_backup_loc(err, loc);
-			parser_log(self.err);
+			self.err = diag_push(err_backup_loc(err, loc));
+			parser_log(diag_get(self.err));
 		}
 		else
 		{
@@ -192,9 +209,9 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [proc_sym, err] = scope_return_matches_proc_sym(ctx.scope, expr.semexpr); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (expr.err == false)  // Limit error propagation
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
 		else
 		{
@@ -209,23 +226,23 @@ namespace s22
 	{
 		Parse_Unit self = {};
 
-		If_Condition *next_if = nullptr;
+		AST next_if = {};
 		if (next.ast.kind != AST::NIL)
 		{
 			// Find the first if condition to join to
-			for (auto n = next.ast.as_if; n != nullptr; n = n->prev)
+			for (auto n = next.ast; n.kind != AST::NIL; n = n.as_if()->prev)
 				next_if = n;
 		}
 
-		self.ast = ast_if({}, cond.ast, block.ast.as_block, next_if);
+		self.ast = ast_if({}, cond.ast, block.ast, next_if);
 		return self;
 	}
 
 	Parse_Unit
 	Parser::else_if_cond(Parse_Unit &prev, const Parse_Unit &cond, const Parse_Unit &block)
 	{
-		auto else_if = ast_if(prev.ast.as_if, cond.ast, block.ast.as_block, {});
-		prev.ast.as_if->next = else_if.as_if;
+		auto else_if = ast_if(prev.ast, cond.ast, block.ast, {});
+		prev.ast.as_if()->next = else_if;
 
 		Parse_Unit self = {};
 		self.ast = else_if;
@@ -239,28 +256,28 @@ namespace s22
 
 		auto [expr, _] = semexpr_literal(nullptr, lit, base);
 		self.semexpr = expr;
-		self.ast = ast_literal(&lit);
+		self.ast = ast_literal(lit);
 
 		return self;
 	}
 
 	Parse_Unit
-	Parser::id(Source_Location loc, const String &id)
+	Parser::id(Source_Location loc, Str_Id id)
 	{
 		Parse_Unit self = { .loc = loc };
 		self.loc = loc;
 
 		auto &ctx = this->context.top();
-		if (auto [expr, err] = semexpr_id(ctx.scope, id.data); err)	// Verify semantics
+		if (auto [expr, err] = semexpr_id(ctx.scope, id); err)	// Verify semantics
 		{
-			self.err = err_backup_loc(err, loc);
-			parser_log(self.err);
+			self.err = diag_push(err_backup_loc(err, loc));
+			parser_log(diag_get(self.err));
 		}
-		else if (auto sym = scope_get_sym(ctx.scope, id.data))		// Build AST
+		else if (auto sym = scope_get_sym(ctx.scope, id))		// Build AST
 		{
 			// exclude arrays from initialization check
-			if (sym->is_set == false && sym->type.array == 0)
-				parser_log(Error{ loc, "uninitialized identifier" }, Log_Level::WARNING);
+			if (sym->is_set == false && semexpr_array(sym->type) == 0)
+				parser_log(Error{ loc, E_UNINITIALIZED_IDENTIFIER }, Log_Level::WARNING);
 
 			self.semexpr = expr;
 			self.ast = ast_symbol(sym);
@@ -270,18 +287,18 @@ namespace s22
 	}
 
 	Parse_Unit
-	Parser::array_access(Source_Location loc, const String &id, const Parse_Unit &right)
+	Parser::array_access(Source_Location loc, Str_Id id, const Parse_Unit &right)
 	{
 		Parse_Unit self = {.loc = loc};
 		
 		auto &ctx = this->context.top();
-		if (auto [expr, err] = semexpr_array_access(ctx.scope, id.data, right); err)
+		if (auto [expr, err] = semexpr_array_access(ctx.scope, id, right); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
-		else if (auto sym = scope_get_sym(ctx.scope, id.data))
+		else if (auto sym = scope_get_sym(ctx.scope, id))
 		{
 			self.semexpr = expr;
 			self.ast = ast_array_access(sym, right.ast);
@@ -291,18 +308,18 @@ namespace s22
 	}
 
 	Parse_Unit
-	Parser::assign(Source_Location loc, const String &id, Asn op, const Parse_Unit &right)
+	Parser::assign(Source_Location loc, Str_Id id, Asn op, const Parse_Unit &right)
 	{
 		Parse_Unit self = {.loc = loc};
 		
 		auto &ctx = this->context.top();
-		if (auto [expr, err] = semexpr_assign(ctx.scope, id.data, right, op); err)
+		if (auto [expr, err] = semexpr_assign(ctx.scope, id, right, op); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
-		else if (auto sym = scope_get_sym(ctx.scope, id.data))
+		else if (auto sym = scope_get_sym(ctx.scope, id))
 		{
 			self.ast = ast_assign((Assignment::KIND)op, ast_symbol(sym), right.ast);
 		}
@@ -318,9 +335,9 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [expr, err] = semexpr_array_assign(ctx.scope, left, right, op); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
 
 		else
@@ -339,14 +356,14 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [expr, err] = semexpr_binary(ctx.scope, left, right, op); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (left.err == false && right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
 		else
 		{
 			self.semexpr = expr;
-			self.ast = ast_binary((Binary_Op::KIND)op, left.ast, right.ast);
+			self.ast = ast_binary((Binary_Op::KIND)op, semexpr_base(left.semexpr), left.ast, right.ast);
 		}
 
 		return self;
@@ -360,14 +377,14 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [expr, err] = semexpr_unary(ctx.scope, right, op); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
 		else
 		{
 			self.semexpr = expr;
-			self.ast = ast_unary((Unary_Op::KIND)op, right.ast);
+			self.ast = ast_unary((Unary_Op::KIND)op, semexpr_base(right.semexpr), right.ast);
 		}
 
 		return self;
@@ -388,17 +405,17 @@ namespace s22
 	}
 
 	Parse_Unit
-	Parser::pcall(Source_Location loc, const String &id)
+	Parser::pcall(Source_Location loc, Str_Id id)
 	{
 		Parse_Unit self = {.loc = loc};
 
-		auto ctx = ctx_pop_no_scope(this->context);
+		auto &ctx = ctx_pop_no_scope(this->context);
 
 		auto params = Buf<Parse_Unit>::view(ctx.proc_call_arguments);
 
-		if (auto [expr, err] = semexpr_proc_call(ctx.scope, id.data, params); err)
+		if (auto [expr, err] = semexpr_proc_call(ctx.scope, id, params); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			bool unique_error = true;
 			for (const auto &unit : params)
 			{
@@ -410,16 +427,17 @@ namespace s22
 			}
 
 			if (unique_error)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
-		else if (auto sym = scope_get_sym(ctx.scope, id.data))
+		else if (auto sym = scope_get_sym(ctx.scope, id))
 		{
 			self.semexpr = expr;
 
 			// Build ast arguments
-			auto ast_args = Buf<AST>::make(params.count);
+			auto ast_args = ast_range_make(params.count);
+			auto children = ast_children(ast_args);
 			for (size_t i = 0; i < params.count; i++)
-				ast_args[i] = params[i].ast;
+				children[i] = params[i].ast;
 
 			self.ast = ast_pcall(sym, ast_args);
 		}
@@ -427,7 +445,7 @@ namespace s22
 	}
 
 	Parse_Unit
-	Parser::decl(Source_Location loc, const String &id, Semantic_Expr type)
+	Parser::decl(Source_Location loc, Str_Id id, Semantic_Expr type)
 	{
 		Parse_Unit self = { .loc = loc };
 		Symbol symbol = { .id = id, .type = type, .defined_at = loc };
@@ -435,19 +453,19 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [sym, err] = scope_add_decl(ctx.scope, symbol); err)
 		{
-			self.err = err_backup_loc(err, loc);
-			parser_log(self.err);
+			self.err = diag_push(err_backup_loc(err, loc));
+			parser_log(diag_get(self.err));
 		}
 		else
 		{
-			ctx.stack_offset += std::max(1ui64, symbol.type.array);
+			ctx.stack_offset += std::max(uint64_t{1}, semexpr_array(symbol.type));
 			self.ast = ast_decl(sym, AST{});
 		}
 		return self;
 	}
 
 	Parse_Unit
-	Parser::decl_expr(Source_Location loc, const String &id, Semantic_Expr type, const Parse_Unit &right)
+	Parser::decl_expr(Source_Location loc, Str_Id id, Semantic_Expr type, const Parse_Unit &right)
 	{
 		Parse_Unit self = { .loc = loc };
 		Symbol symbol = { .id = id, .type = type, .defined_at = loc };
@@ -455,13 +473,13 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [sym, err] = scope_add_decl(ctx.scope, symbol, right); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
 		else
 		{
-			ctx.stack_offset += std::max(1ui64, symbol.type.array);
+			ctx.stack_offset += std::max(uint64_t{1}, semexpr_array(symbol.type));
 			self.ast = ast_decl(sym, right.ast);
 		}
 		
@@ -469,7 +487,7 @@ namespace s22
 	}
 
 	Parse_Unit
-	Parser::decl_const(Source_Location loc, const String &id, Semantic_Expr type, const Parse_Unit &right)
+	Parser::decl_const(Source_Location loc, Str_Id id, Semantic_Expr type, const Parse_Unit &right)
 	{
 		Parse_Unit self = {.loc = loc};
 		Symbol symbol = {.id = id, .type = type, .defined_at = loc, .is_constant = true};
@@ -477,13 +495,13 @@ namespace s22
 		auto &ctx = this->context.top();
 		if (auto [sym, err] = scope_add_decl(ctx.scope, symbol, right); err)
 		{
-			self.err = err_backup_loc(err, loc);
+			self.err = diag_push(err_backup_loc(err, loc));
 			if (right.err == false)
-				parser_log(self.err);
+				parser_log(diag_get(self.err));
 		}
 		else
 		{
-			ctx.stack_offset += std::max(1ui64, symbol.type.array);
+			ctx.stack_offset += std::max(uint64_t{1}, semexpr_array(symbol.type));
 			self.ast = ast_decl(sym, right.ast);
 		}
 
@@ -512,21 +530,20 @@ namespace s22
 	Parser::decl_proc_params_add(const Parse_Unit &arg)
 	{
 		auto &ctx = this->context.top();
-		ctx.decl_proc_arguments.push_back(arg.ast.as_decl);
+		ctx.decl_proc_arguments.push_back(arg.ast);
 	}
 
 	void
-	Parser::decl_proc_params_end(Source_Location loc, const String &id, const Semantic_Expr &ret)
+	Parser::decl_proc_params_end(Source_Location loc, Str_Id id, const Semantic_Expr &ret)
 	{
 		auto &ctx = this->context.top();
 
-		Semantic_Expr proc_type = {.base = Semantic_Expr::PROC};
-		proc_type.procedure = scope_make_proc(ctx.scope, ret);
+		Semantic_Expr proc_type = scope_make_proc(ctx.scope, ret);
 
 		// remove size from context stack offset
-		for (const auto &arg: proc_type.procedure->parameters)
+		for (const auto &arg: semexpr_procedure(proc_type)->parameters)
 		{
-			uint64_t size = std::max(1ui64, arg.array); // in words
+			uint64_t size = std::max(uint64_t{1}, semexpr_array(arg)); // in words
 			ctx.stack_offset -= size;
 		}
 
@@ -543,25 +560,25 @@ namespace s22
 	}
 
 	Parse_Unit
-	Parser::decl_proc_end(const String &id)
+	Parser::decl_proc_end(Str_Id id)
 	{
 		Parse_Unit self = {};
 		
 		// Create block statements
 		// Keep old stack offset
 		// Pop context
-		auto proc_ctx = std::move(this->context.top());
-		auto block = ast_block(Buf<AST>::clone(proc_ctx.block_stmts), proc_ctx.stack_offset);
-		auto args = Buf<Decl *>::clone(proc_ctx.decl_proc_arguments);
+		auto &proc_ctx = this->context.top();
+		auto block = ast_block(ast_range_clone(proc_ctx.block_stmts), proc_ctx.stack_offset);
+		auto args = ast_range_clone(proc_ctx.decl_proc_arguments);
 
 		this->context.pop();
 		scope_pop(proc_ctx.scope);
 
 		auto &ctx = this->context.top();
-		if (auto sym = scope_get_sym(ctx.scope, id.data))
+		if (auto sym = scope_get_sym(ctx.scope, id))
 		{
 			self.loc = sym->defined_at;
-			self.ast = ast_decl_proc(sym, args, block.as_block);
+			self.ast = ast_decl_proc(sym, args, block);
 		}
 
 		return self;
@@ -571,7 +588,7 @@ namespace s22
 	Parser::switch_begin(const Parse_Unit &expr)
 	{
 		if (semexpr_is_integral(expr.semexpr) == false)
-			return parser_log(Error{ expr.loc, "invalid type" });
+			return parser_log(Error{ expr.loc, E_INVALID_TYPE });
 
 		auto &ctx = ctx_push_no_scope(this->context);
 		ctx.switch_expr = expr.ast;
@@ -582,12 +599,13 @@ namespace s22
 	{
 		Parse_Unit self = { .loc = loc };
 
-		auto ctx = ctx_pop_no_scope(this->context);
+		auto &ctx = ctx_pop_no_scope(this->context);
 
 		// Collect switch cases from context
-		auto switch_cases = Buf<Switch_Case*>::make(ctx.switch_cases.size());
-		for (size_t i = 0; i < switch_cases.count; i++)
-			switch_cases[i] = ctx.switch_cases[i].ast_sw_case;
+		auto switch_cases = ast_range_make(ctx.switch_cases.size());
+		auto children = ast_children(switch_cases);
+		for (size_t i = 0; i < children.count; i++)
+			children[i] = ctx.switch_cases[i].ast_sw_case;
 
 		self.ast = ast_switch(switch_cases, ctx.switch_default);
 		return self;
@@ -609,7 +627,7 @@ namespace s22
 		if (expr.is_literal == false || semexpr_is_integral(expr) == false)
 		{
 			if (literal.err == false)
-				parser_log(Error{ literal.loc, "invalid case" });
+				parser_log(Error{ literal.loc, E_INVALID_CASE });
 
 			return;
 		}
@@ -620,14 +638,14 @@ namespace s22
 		{
 			for (auto &lit: sw_case.group)
 			{
-				if (*lit == *literal.ast.as_lit)
-					return parser_log(Error{ literal.loc, "duplicate case" });
+				if (*lit.as_lit() == *literal.ast.as_lit())
+					return parser_log(Error{ literal.loc, E_DUPLICATE_CASE });
 			}
 		}
 
 		// Add lit to last case
 		auto &last_case = ctx.switch_cases.back();
-		last_case.group.push_back(literal.ast.as_lit);
+		last_case.group.push_back(literal.ast);
 	}
 
 	void
@@ -638,29 +656,27 @@ namespace s22
 		// Add literals in last case
 		auto &last_case = ctx.switch_cases.back();
 
-		auto group = Buf<Literal*>::make(last_case.group.size());
-		for (size_t i = 0; i < group.count; i++)
-			group[i] = last_case.group[i];
+		auto group = ast_range_clone(last_case.group);
 
 		// Add block
-		last_case.ast_sw_case = ast_switch_case(ctx.switch_expr, group, block.ast.as_block).as_case;
+		last_case.ast_sw_case = ast_switch_case(ctx.switch_expr, group, block.ast);
 	}
 
 	void
 	Parser::switch_default(Source_Location loc, const Parse_Unit &block)
 	{
 		auto &ctx = this->context.top();
-		if (ctx.switch_default != nullptr)
-			return parser_log(Error{ loc, "duplicate default" });
+		if (ctx.switch_default.kind != AST::NIL)
+			return parser_log(Error{ loc, E_DUPLICATE_DEFAULT });
 
-		ctx.switch_default = block.ast.as_block;
+		ctx.switch_default = block.ast;
 	}
 
 	Parse_Unit
 	Parser::while_loop(Source_Location loc, const Parse_Unit &cond, const Parse_Unit &block)
 	{
 		Parse_Unit self = { .loc = loc };
-		self.ast = ast_while(cond.ast, block.ast.as_block);
+		self.ast = ast_while(cond.ast, block.ast);
 		return self;
 	}
 
@@ -668,7 +684,7 @@ namespace s22
 	Parser::do_while_loop(Source_Location loc, const Parse_Unit &cond, const Parse_Unit &block)
 	{
 		Parse_Unit self = { .loc = loc };
-		self.ast = ast_do_while(cond.ast, block.ast.as_block);
+		self.ast = ast_do_while(cond.ast, block.ast);
 		return self;
 	}
 
@@ -683,158 +699,392 @@ namespace s22
 	{
 		Parse_Unit self = { .loc = loc };
 		auto block = this->block_end();
-		self.ast = ast_for(init.ast, cond.ast, post.ast, block.ast.as_block);
+		self.ast = ast_for(init.ast, cond.ast, post.ast, block.ast);
 		return self;
 	}
 
 	Parser::~Parser()
 	{
-		this->dispose();
+		source_free(this->ui_source_code.file);
+		backend_free(this->backend);
+		if (this->scanner != nullptr)
+			lexer_free(this->scanner);
+		arena_free(&this->arena);
 	}
 
+	// Parser bound to the calling thread, nullptr if none
+	static thread_local Parser *bound_parser = nullptr;
+
 	Parser *
 	parser_instance()
 	{
+		if (bound_parser != nullptr)
+			return bound_parser;
+
 		static Parser self = {};
 		return &self;
 	}
 
-	void
-	parser_log(const Error &err, Log_Level lvl)
+	Parser *
+	parser_bind(Parser *self)
 	{
-		auto parser = parser_instance();
-		if (lvl == Log_Level::ERROR)
-			parser->has_errors = true;
+		auto prev = bound_parser;
+		bound_parser = self;
+		return prev;
+	}
 
-		auto msg = std::format("{}: {}", lvl, err);
+	// Lex the padded code in place on the parser's scanner, or with the hand-written lexer
+	inline static bool
+	parser_tokenize(Parser *self, char *code, size_t size, Source_Location &end)
+	{
+		if (self->lexer == Lexer_Engine::SIMD)
+		{
+			lexer_simd_tokenize(code, size, 0, self->tokens, end);
+			return true;
+		}
 
-		yyerror(&err.loc, nullptr, msg.c_str());
+		if (self->scanner == nullptr)
+			self->scanner = lexer_new();
 
-		if (lvl == Log_Level::CRITICAL)
-			s22_unreachable_msg("CRITICAL ERROR");
+		auto lexer_buf = self->scanner ? lexer_scan_buffer(self->scanner, code, size + LEXER_PADDING) : nullptr;
+		if (lexer_buf == nullptr)
+			return false;
+
+		lexer_tokenize(self->scanner, 0, self->tokens, end);
+		lexer_delete_buffer(self->scanner, lexer_buf);
+		return true;
 	}
 
-	void
-	location_reduce(Source_Location &current, Source_Location *rhs, size_t N)
+	// A line break always ends a token, split the code after line breaks and lex the chunks on the pool
+	// Each chunk is lexed into its own stream, by its own scanner for flex, the streams are joined in order
+	inline static bool
+	parser_tokenize_parallel(Parser *self, const char *code, size_t size, Source_Location &end)
 	{
-		if (N != 0)
+		auto chunk_size = std::max(LEXER_CHUNK_MIN, size / (pool_worker_count(self->pool) * 4));
+
+		std::vector<size_t> starts = { 0 };
+		for (size_t pos = chunk_size; pos < size; pos += chunk_size)
+		{
+			auto nl = (const char *)::memchr(code + pos, '\n', size - pos);
+			if (nl == nullptr)
+				break;
+
+			pos = nl - code + 1;
+			if (pos < size)
+				starts.push_back(pos);
+		}
+		starts.push_back(size);
+
+		auto count = starts.size() - 1;
+		std::vector<Token_Stream> chunks(count);
+		std::vector<Source_Location> ends(count);
+		std::vector<uint8_t> failed(count); // not vector<bool>, its elements share bytes
+
+		pool_for(self->pool, count, [&](size_t i, size_t) {
+			auto chunk = code + starts[i];
+			auto chunk_len = starts[i + 1] - starts[i];
+			if (self->lexer == Lexer_Engine::SIMD)
+			{
+				lexer_simd_tokenize(chunk, chunk_len, (uint32_t)starts[i], chunks[i], ends[i]);
+				return;
+			}
+
+			auto scanner = lexer_new();
+			auto lexer_buf = scanner ? lexer_scan_bytes(scanner, chunk, chunk_len) : nullptr;
+			if (lexer_buf == nullptr)
+			{
+				failed[i] = 1;
+			}
+			else
+			{
+				lexer_tokenize(scanner, (uint32_t)starts[i], chunks[i], ends[i]);
+				lexer_delete_buffer(scanner, lexer_buf);
+			}
+
+			if (scanner)
+				lexer_free(scanner);
+		});
+
+		if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+			return false;
+
+		for (size_t i = 0; i < count; i++)
 		{
-			current.first_line = rhs[1].first_line;
-			current.first_column = rhs[1].first_column;
-			current.last_line = rhs[N].last_line;
-			current.last_column = rhs[N].last_column;
+			token_stream_append(self->tokens, chunks[i]);
+			if (ends[i].length != 0)
+				end = ends[i];
 		}
+		return true;
+	}
+
+	// Lex the whole source, unless reuse is on and it is the code the kept tokens came from
+	inline static bool
+	parser_lex(Parser *self, char *code, size_t size)
+	{
+		auto &tokens = self->tokens;
+		Hash_128 hash = {};
+		if (self->reuse_tokens)
+		{
+			hash = hash_bytes(code, size);
+			self->stats.tokens_reused = tokens.count() != 0 && tokens.code_size == size && tokens.hash == hash;
+			if (self->stats.tokens_reused)
+				return true;
+		}
+
+		token_stream_clear(tokens);
+
+		// Code without lexemes ends where it starts
+		Source_Location end = { 0, 0 };
+		bool lexed = false;
+		if (self->pool != nullptr && size >= 2 * LEXER_CHUNK_MIN)
+			lexed = parser_tokenize_parallel(self, code, size, end);
 		else
+			lexed = parser_tokenize(self, code, size, end);
+
+		if (lexed == false)
 		{
-			current.first_line = current.last_line = rhs[0].last_line;
-			current.first_column = current.last_column = rhs[0].last_column;
+			token_stream_clear(tokens);
+			return false;
 		}
+
+		// End of input, located at the last lexeme like the scanner left it
+		token_stream_push(tokens, 0, end, 0);
+		lexer_resolve_names(tokens, self->source);
+		tokens.hash = hash;
+		tokens.code_size = size;
+		return true;
 	}
 
-	void
-	location_update(Source_Location *loc)
+	bool
+	parser_compile(Parser *self, char *code, size_t size)
 	{
-		// New line
-		if (yytext[yyleng - 1] == '\n')
+		auto prev = parser_bind(self);
+		s22_defer { parser_bind(prev); };
+
+		// Discard old data
+		self->dispose();
+		self->source = { code, size };
+
+		auto &stats = self->stats;
+		bool lexed = false;
 		{
-			yycolno = 1;
-			return;
+			Phase_Timer timer = { stats.lex };
+			lexed = parser_lex(self, code, size);
 		}
 
-		// Current line and column
-		loc->first_line = yylineno;
-		loc->first_column = yycolno;
+		if (lexed == false)
+		{
+			parser_log(Error{E_LEXER_BUFFER});
+			return false;
+		}
+
+		self->token_names.resize(self->tokens.names.size());
+		{
+			Phase_Timer timer = { stats.parse };
+			yyparse(self);
+		}
 
-		// Next line and column
-		loc->last_line = yylineno;
-		loc->last_column = loc->first_column + yyleng - 1;
+		// Code generation runs in the last action of the parser, keep the phases apart
+		stats.parse -= stats.codegen + stats.optimize;
 
-		// Update current column
-		yycolno = loc->last_column + 1;
+		stats.tokens = self->tokens.count();
+		for (size_t i = 0; i < AST_KIND_COUNT; i++)
+			stats.nodes[i] = ast_pool_count(&self->asts, (AST::KIND)i);
+		stats.arena_bytes = self->arena.bytes_used;
+		stats.quadruples = self->backend ? backend_instruction_count(self->backend) : 0;
+		return self->has_errors == false;
 	}
 
-	void
-	location_print(FILE *out, const Source_Location *const loc)
+	Arena *
+	arena_instance()
 	{
-		auto str = std::format("{}", *loc);
-		fprintf(out, "%s", str.data());
+		return &parser_instance()->arena;
 	}
-}
 
+	Str_Table *
+	str_table_instance()
+	{
+		return &parser_instance()->strings;
+	}
 
-void
-yyerror(const s22::Source_Location *location, s22::Parser *p, const char *message)
-{
-	auto parser = s22::parser_instance();
-	auto &source_code = parser->ui_source_code;
+	Type_Table *
+	type_table_instance()
+	{
+		return &parser_instance()->types;
+	}
 
-	if (*location == s22::Source_Location{})
+	AST_Pool *
+	ast_pool_instance()
 	{
-		parser->ui_logs.emplace_back(message);
-		return;
+		return &parser_instance()->asts;
 	}
-	else
+
+	Diag_Id
+	diag_push(const Error &err)
 	{
-		parser->ui_logs.push_back(std::format("({}) {}", location->last_line, message));
+		auto &self = parser_instance()->diagnostics;
+		if (self.empty())
+			self.emplace_back(); // reserved
+
+		Diag_Id id = { (uint32_t)self.size() };
+		self.push_back(err);
+		return id;
+	}
+
+	const Error &
+	diag_get(Diag_Id id)
+	{
+		static const Error none = {};
+
+		auto &self = parser_instance()->diagnostics;
+		if (id.idx >= self.size())
+			return none;
+		return self[id.idx];
 	}
 
-	// Read file line by line into buffer
-	char buf[1024 + 1] = {};
-	size_t lines_to_read = location->first_line;
-	size_t position_in_source_code = 0;
-	
-	while (lines_to_read > 0)
+	inline static void
+	log_push(Parser *self, const Error &err, Log_Level lvl, bool show_level)
 	{
-		size_t i = 0;
-		for (; i + 1 < sizeof(buf) && position_in_source_code < source_code.count; i++)
+		Log log = { .err = err, .lvl = lvl, .show_level = show_level };
+
+		uint32_t lines = 1;
+		if (err.loc != LOCATION_NONE)
 		{
-			char c = source_code.buf[position_in_source_code++];
-			if (c == '\n')
-			{
-				break;
-			}
-			else
+			// Logs are formatted later, when the code may have changed or been unloaded
+			if (self->log_source_taken == false)
 			{
-				buf[i] = c;
+				auto &snapshot = self->log_sources.emplace_back();
+				line_table_build(&snapshot.lines, self->source.data(), self->source.size());
+				self->log_source_taken = true;
 			}
+			log.source = (uint32_t)self->log_sources.size() - 1;
+
+			// Copy the line the location starts at
+			auto &snapshot = self->log_sources.back();
+			auto &starts = snapshot.lines.starts;
+			auto line_no = line_table_find(&snapshot.lines, err.loc.offset).line;
+			size_t begin = starts[line_no - 1];
+			size_t end = line_no < starts.size() ? starts[line_no] - 1 : self->source.size();
+
+			log.code = (uint32_t)snapshot.code.size();
+			log.code_size = (uint32_t)std::min<size_t>(end - begin, 1024);
+			snapshot.code.append(self->source.data() + begin, log.code_size);
+			lines = 3;
 		}
-		
-		buf[i] = '\0';
-		lines_to_read--;
-	}
 
-	// Log error
-	parser->ui_logs.emplace_back(buf);
+		auto log_idx = (uint32_t)self->logs.size();
+		self->logs.push_back(log);
+		for (uint32_t i = 0; i < lines; i++)
+			self->ui_logs.push_back({ log_idx, i });
+	}
 
-	// Print indicator
-	for (size_t i = 0; i < strlen(buf); i++)
+	void
+	parser_log(const Error &err, Log_Level lvl)
 	{
-		if (i == location->first_column - 1)
-			buf[i] = '^';
+		auto parser = parser_instance();
+		if (lvl == Log_Level::ERROR)
+			parser->has_errors = true;
+
+		log_push(parser, err, lvl, true);
 
-		else if (isspace(buf[i]) == false)
-			buf[i] = ' ';
+		if (lvl == Log_Level::CRITICAL)
+			s22_unreachable_msg("CRITICAL ERROR");
 	}
-	parser->ui_logs.emplace_back(buf);
-}
 
-template <>
-struct std::formatter<s22::Log_Level> : std::formatter<std::string>
-{
-	auto
-	format(s22::Log_Level lvl, format_context &ctx)
+	std::string
+	parser_log_line(size_t i)
 	{
-		const char *str = "UNREACHABLE";
-		switch (lvl)
+		auto parser = parser_instance();
+		auto [log_idx, line] = parser->ui_logs[i];
+		auto &log = parser->logs[log_idx];
+		auto &loc = log.err.loc;
+
+		if (loc == LOCATION_NONE)
+			return log.show_level ? std::format("{}: {}", log.lvl, log.err) : std::format("{}", log.err);
+
+		// The locations in the log resolve against the snapshot's lines
+		auto &source = parser->log_sources[log.source];
+		if (line == 0)
 		{
-		case s22::Log_Level::INFO:    str = "INFO"; break;
-		case s22::Log_Level::ERROR:   str = "ERROR"; break;
-		case s22::Log_Level::WARNING: str = "WARNING"; break;
+			parser->log_lines = &source.lines;
+			auto msg = log.show_level ? std::format("{}: {}", log.lvl, log.err) : std::format("{}", log.err);
+			parser->log_lines = nullptr;
+
+			return std::format("({}) {}", line_table_find(&source.lines, location_last(loc)).line, msg);
+		}
+
+		// Copy of the line the location starts at
+		auto column = line_table_find(&source.lines, loc.offset).column;
+		std::string buf = source.code.substr(log.code, log.code_size);
+
+		// Print indicator
+		if (line == 2)
+		{
+			for (size_t i = 0; i < buf.size(); i++)
+			{
+				if (i == column - 1)
+					buf[i] = '^';
 
-		default:
-			break;
+				else if (isspace(buf[i]) == false)
+					buf[i] = ' ';
+			}
+		}
+		return buf;
+	}
+
+	void
+	parser_log_clear()
+	{
+		auto parser = parser_instance();
+		parser->logs.clear();
+		parser->log_sources.clear();
+		parser->log_source_taken = false;
+		parser->ui_logs.clear();
+	}
+
+	void
+	location_reduce(Source_Location &current, Source_Location *rhs, size_t N)
+	{
+		if (N != 0)
+		{
+			current.offset = rhs[1].offset;
+			current.length = rhs[N].offset + rhs[N].length - rhs[1].offset;
 		}
+		else
+		{
+			// Empty production, placed at the end of the previous symbol
+			current.offset = location_last(rhs[0]);
+			current.length = 0;
+		}
+	}
 
-		return format_to(ctx.out(), "{}", str);
+	Line_Col
+	location_line_col(uint32_t offset)
+	{
+		auto parser = parser_instance();
+		if (parser->log_lines != nullptr)
+			return line_table_find(parser->log_lines, offset);
+
+		// Locations of the current compilation, e.g. in the symbol table
+		auto &lines = parser->source_lines;
+		if (lines.starts.empty())
+			line_table_build(&lines, parser->source.data(), parser->source.size());
+
+		return line_table_find(&lines, offset);
+	}
+
+	void
+	location_print(FILE *out, const Source_Location *const loc)
+	{
+		auto str = std::format("{}", *loc);
+		fprintf(out, "%s", str.data());
 	}
-};
\ No newline at end of file
+}
+
+
+void
+yyerror(const s22::Source_Location *location, s22::Parser *p, const char *message)
+{
+	// Messages come from the lexer and Bison as string literals, they outlive the log
+	s22::log_push(p, s22::Error{*location, s22::E_MESSAGE, message}, s22::Log_Level::ERROR, false);
+}
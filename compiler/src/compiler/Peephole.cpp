@@ -0,0 +1,195 @@
+#include "compiler/Peephole.h"
+#include "compiler/CFG.h"
+
+#include <unordered_map>
+
+namespace s22
+{
+	struct Peephole
+	{
+		Program *program;
+		std::vector<uint8_t> keep;
+		std::vector<uint32_t> visited;					// branch that last threaded through each instruction
+		Label_Index index;								// label -> instruction, the first definition wins
+		std::unordered_map<uint64_t, uint32_t> refs;	// label -> number of branches and calls to it
+		std::unordered_map<uint64_t, Label> merged;		// label -> label of the same instruction that replaced it
+	};
+
+	// Label without an instruction, procedure labels also open a procedure that the code around flows past
+	inline static bool
+	peephole_is_label_only(const Peephole &self, uint32_t i)
+	{
+		auto &program = *self.program;
+		return program.ops[i].op == I_NOP && program.labels[i].type != Label::PROC;
+	}
+
+	// First instruction executed when control reaches i, skipping labels
+	inline static uint32_t
+	peephole_landing(const Peephole &self, uint32_t i)
+	{
+		auto count = (uint32_t)self.program->count();
+		while (i < count && (self.keep[i] == false || peephole_is_label_only(self, i)))
+			i++;
+		return i;
+	}
+
+	// Branch through the unconditional branches at its target, a cycle of them stops the walk
+	inline static void
+	peephole_thread(Peephole &self, uint32_t i)
+	{
+		auto &program = *self.program;
+		auto &dst = program.operands[3 * i];
+
+		auto target = dst.label;
+		while (target.type != Label::END_PROC)
+		{
+			auto t = label_index_find(self.index, target);
+			if (t == CFG_NONE)
+				break;
+
+			auto j = peephole_landing(self, t);
+			if (j == program.count() || program.ops[j].op != I_BR || j == i || self.visited[j] == i)
+				break;
+
+			self.visited[j] = i;
+			target = program.operands[3 * j].label;
+		}
+
+		dst.label = target;
+	}
+
+	// Whether control gets to the same instruction whether the branch at i is taken or not
+	inline static bool
+	peephole_branches_to_next(const Peephole &self, uint32_t i)
+	{
+		auto &program = *self.program;
+		auto target = program.operands[3 * i].label;
+
+		auto next = peephole_landing(self, i + 1);
+		if (next < program.count() && label_key(program.labels[next]) == label_key(target))
+			return true;
+
+		// Falling through to a branch to the same target, left behind when threading moved this one past its own
+		if (next < program.count() && program.ops[next].op == I_BR && label_key(program.operands[3 * next].label) == label_key(target))
+			return true;
+
+		// Procedures may share a name, returns only ever land on the end of their own
+		if (target.type == Label::END_PROC)
+			return false;
+
+		// The target lands on next, or both are past the last instruction when nothing follows
+		auto t = label_index_find(self.index, target);
+		return t != CFG_NONE && peephole_landing(self, t) == next;
+	}
+
+	// Procedure labels are kept, calls and the code structure refer to them
+	inline static bool
+	peephole_is_unused(const Peephole &self, Label label)
+	{
+		if (label.type == Label::PROC || label.type == Label::END_PROC)
+			return false;
+		return label.type == Label::NONE || self.refs.contains(label_key(label)) == false;
+	}
+
+	inline static Label
+	peephole_resolve(const Peephole &self, Label label)
+	{
+		for (auto it = self.merged.find(label_key(label)); it != self.merged.end(); it = self.merged.find(label_key(label)))
+			label = it->second;
+		return label;
+	}
+
+	// Single pass over the program, returns the number of instructions it removed
+	inline static size_t
+	peephole_pass(Peephole &self)
+	{
+		auto &program = *self.program;
+		auto count = (uint32_t)program.count();
+
+		self.keep.assign(count, 1);
+		self.visited.assign(count, CFG_NONE);
+		label_index_build(self.index, program);
+		self.refs.clear();
+		self.merged.clear();
+
+		// Jump chains, then the branches that end up where they would have fallen
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (op_is_branch(program.ops[i].op))
+				peephole_thread(self, i);
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (op_is_branch(program.ops[i].op) && peephole_branches_to_next(self, i))
+			{
+				if (program.labels[i].type == Label::NONE)
+				{
+					self.keep[i] = 0;
+				}
+				else
+				{
+					program.ops[i] = { I_NOP, 0, 0 };
+					program.operands[3 * i] = {};
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (self.keep[i] && program.ops[i].operand_count != 0 && program.operands[3 * i].loc == OP_LBL)
+				self.refs[label_key(program.operands[3 * i].label)]++;
+		}
+
+		// Labels nothing branches to are dropped, the rest move onto the instruction they fall into
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (self.keep[i] == false)
+				continue;
+
+			auto &label = program.labels[i];
+			if (peephole_is_unused(self, label))
+				label = {};
+
+			if (program.ops[i].op != I_NOP || label.type == Label::PROC)
+				continue;
+
+			uint32_t j = i + 1;
+			while (j < count && self.keep[j] == false)
+				j++;
+
+			if (label.type == Label::NONE)
+			{
+				self.keep[i] = 0;
+			}
+			else if (j < count && program.labels[j].type != Label::PROC)
+			{
+				if (peephole_is_unused(self, program.labels[j]))
+					program.labels[j] = label;
+				else
+					self.merged[label_key(label)] = program.labels[j];
+				self.keep[i] = 0;
+			}
+		}
+
+		auto removed = program_compact(program, self.keep);
+		for (uint32_t i = 0; i < program.count(); i++)
+		{
+			if (program.ops[i].operand_count != 0 && program.operands[3 * i].loc == OP_LBL)
+				program.operands[3 * i].label = peephole_resolve(self, program.operands[3 * i].label);
+		}
+		return removed;
+	}
+
+	size_t
+	peephole_optimize(Program &program)
+	{
+		Peephole self = {};
+		self.program = &program;
+
+		// Removing a branch can leave its label unused, a few passes reach the fixed point
+		size_t removed = 0;
+		while (auto n = peephole_pass(self))
+			removed += n;
+		return removed;
+	}
+}
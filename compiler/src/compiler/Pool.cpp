@@ -0,0 +1,165 @@
+#include "compiler/Pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace s22
+{
+	// Pending indices of one worker, the owner pops the front and thieves take the back
+	struct Pool_Queue
+	{
+		std::mutex mtx;
+		std::deque<size_t> jobs;
+	};
+
+	struct IPool
+	{
+		std::vector<std::thread> workers;
+		std::unique_ptr<Pool_Queue[]> queues; // one per worker
+
+		std::mutex mtx;					// guards the fields below
+		std::condition_variable wake;	// signaled when a batch starts or the pool quits
+		std::condition_variable done;	// signaled when a worker leaves a batch
+		const Pool_Job *job;			// job of the current batch, nullptr when idle
+		size_t batch;					// incremented on every pool_for
+		size_t remaining;				// jobs of the current batch that did not finish
+		size_t running;					// workers inside the current batch
+		bool quit;
+	};
+
+	inline static bool
+	pool_pop(Pool self, size_t worker, size_t &i)
+	{
+		// Own queue in order
+		{
+			auto &queue = self->queues[worker];
+			std::lock_guard lock(queue.mtx);
+			if (queue.jobs.empty() == false)
+			{
+				i = queue.jobs.front();
+				queue.jobs.pop_front();
+				return true;
+			}
+		}
+
+		// Steal from the other workers, starting with the next one to spread the thieves
+		auto count = self->workers.size();
+		for (size_t k = 1; k < count; k++)
+		{
+			auto &queue = self->queues[(worker + k) % count];
+			std::lock_guard lock(queue.mtx);
+			if (queue.jobs.empty() == false)
+			{
+				i = queue.jobs.back();
+				queue.jobs.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline static void
+	pool_worker(Pool self, size_t worker)
+	{
+		size_t seen = 0;
+		while (true)
+		{
+			const Pool_Job *job = nullptr;
+			{
+				std::unique_lock lock(self->mtx);
+				self->wake.wait(lock, [&] { return self->quit || self->batch != seen; });
+				if (self->quit)
+					return;
+
+				seen = self->batch;
+				job = self->job;
+
+				// Woke up after the batch was done
+				if (job == nullptr)
+					continue;
+
+				self->running++;
+			}
+
+			size_t finished = 0;
+			for (size_t i = 0; pool_pop(self, worker, i); finished++)
+				(*job)(i, worker);
+
+			std::lock_guard lock(self->mtx);
+			self->remaining -= finished;
+			self->running--;
+			self->done.notify_all();
+		}
+	}
+
+	Pool
+	pool_new(size_t worker_count)
+	{
+		if (worker_count == 0)
+			worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+		auto self = new IPool{};
+		self->queues = std::make_unique<Pool_Queue[]>(worker_count);
+		self->workers.reserve(worker_count);
+		for (size_t i = 0; i < worker_count; i++)
+			self->workers.emplace_back(pool_worker, self, i);
+
+		return self;
+	}
+
+	void
+	pool_free(Pool self)
+	{
+		if (self == nullptr)
+			return;
+
+		{
+			std::lock_guard lock(self->mtx);
+			self->quit = true;
+		}
+		self->wake.notify_all();
+
+		for (auto &worker : self->workers)
+			worker.join();
+
+		delete self;
+	}
+
+	size_t
+	pool_worker_count(Pool self)
+	{
+		return self->workers.size();
+	}
+
+	void
+	pool_for(Pool self, size_t count, const Pool_Job &job)
+	{
+		if (count == 0)
+			return;
+
+		std::unique_lock lock(self->mtx);
+
+		// Deal contiguous runs, neighbouring jobs tend to share data
+		auto workers = self->workers.size();
+		for (size_t w = 0; w < workers; w++)
+		{
+			auto &queue = self->queues[w];
+			std::lock_guard queue_lock(queue.mtx);
+			for (size_t i = w * count / workers; i < (w + 1) * count / workers; i++)
+				queue.jobs.push_back(i);
+		}
+
+		self->job = &job;
+		self->remaining = count;
+		self->batch++;
+		self->wake.notify_all();
+
+		self->done.wait(lock, [&] { return self->remaining == 0 && self->running == 0; });
+		self->job = nullptr;
+	}
+}
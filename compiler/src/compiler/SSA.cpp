@@ -0,0 +1,1073 @@
+#include "compiler/SSA.h"
+#include "compiler/CFG.h"
+#include "compiler/Semantic_Expr.h"
+
+#include <bit>
+#include <utility>
+
+namespace s22
+{
+	// Lattice of the constant propagation, values only move down from TOP to BOTTOM
+	enum SSA_STATE : uint8_t
+	{
+		SSA_TOP,		// no executed definition yet
+		SSA_CONST,		// the same bits on every executed path
+		SSA_BOTTOM,		// varies at runtime
+	};
+
+	struct SSA_Lattice
+	{
+		SSA_STATE state;
+		uint64_t bits;	// set for SSA_CONST
+	};
+
+	constexpr uint32_t SSA_PHI = 1u << 31;			// tags phis among definitions and uses of values
+	constexpr uint32_t SSA_SHARED = CFG_NONE - 1;	// owner of symbols that stay in memory
+
+	// Ways out of a conditional branch found executable
+	constexpr uint8_t SSA_TAKEN = 1;
+	constexpr uint8_t SSA_FALLS = 2;
+
+	struct SSA_Value
+	{
+		SSA_STATE state;
+		uint64_t bits;
+		uint32_t var;
+		uint32_t def;		// defining instruction, phi | SSA_PHI, CFG_NONE for the value on entry
+	};
+
+	struct SSA_Phi
+	{
+		uint32_t block;
+		uint32_t var;
+		uint32_t value;
+		uint32_t args;		// value from the j-th predecessor of block is SSA::args[args + j]
+	};
+
+	using SSA_Pairs = std::vector<std::pair<uint32_t, uint32_t>>;
+
+	// Buffers of the pass, reused by every graph of the program
+	struct SSA
+	{
+		Program *program;
+		Program_CFG cfg;
+
+		// Per instruction, variables until renaming turns them into values
+		std::vector<uint32_t> defs;			// written by the instruction, CFG_NONE if none
+		std::vector<uint32_t> uses;			// read by each operand slot, directly or as an element index
+		std::vector<uint32_t> block_of;		// block of the instruction in its graph
+		std::vector<uint8_t> keep;			// instructions that survive the pass
+
+		// Variables are the temporaries and promoted symbols of a graph, numbered from 0 in each graph
+		std::vector<uint32_t> sym_owner;	// only graph referencing the symbol, or SSA_SHARED
+		std::vector<uint32_t> sym_var, sym_stamp;
+		std::vector<uint32_t> tmp_var, tmp_stamp;
+		std::vector<uint8_t> var_is_tmp;
+		std::vector<uint8_t> var_global;	// read before written in some block, only these get phis
+		std::vector<uint32_t> var_mark, current, entry;
+
+		// Per graph
+		std::vector<SSA_Value> values;
+		std::vector<SSA_Phi> phis;
+		std::vector<uint32_t> args;
+		std::vector<uint32_t> block_phis;	// phis of block b are phis[block_phis[b], block_phis[b + 1])
+		std::vector<uint32_t> phi_vars;
+		std::vector<uint32_t> block_mark, block_mark2;
+		std::vector<uint32_t> site_begin, sites;		// blocks defining each variable
+		std::vector<uint32_t> df_begin, df;				// dominance frontier of each block
+		std::vector<uint32_t> child_begin, children;	// dominator tree
+		std::vector<uint32_t> use_begin, use_list;		// instructions and phi | SSA_PHI reading each value
+		std::vector<uint8_t> executable_block, executable_edge, branch_ways, live;
+		std::vector<uint32_t> flow_work, value_work, work;
+		SSA_Pairs pairs, saved;
+	};
+
+	// Group the second elements of pairs by the first, those of key k land in out[begin[k], begin[k + 1])
+	inline static void
+	ssa_group(const SSA_Pairs &pairs, uint32_t keys, std::vector<uint32_t> &begin, std::vector<uint32_t> &out)
+	{
+		begin.assign(keys + 1, 0);
+		for (auto [k, _] : pairs)
+			begin[k + 1]++;
+		for (uint32_t k = 0; k < keys; k++)
+			begin[k + 1] += begin[k];
+
+		out.resize(pairs.size());
+		for (auto [k, v] : pairs)
+			out[begin[k]++] = v;
+		for (uint32_t k = keys; k > 0; k--)
+			begin[k] = begin[k - 1];
+		begin[0] = 0;
+	}
+
+	inline static bool
+	ssa_reachable(const CFG &graph, uint32_t b)
+	{
+		return graph.blocks[b].dom_begin < graph.blocks[b].dom_end;
+	}
+
+	// Instructions writing their first operand
+	inline static bool
+	ssa_op_writes(INSTRUCTION_OP op)
+	{
+		switch (op)
+		{
+		case I_MOV:
+		case I_ADD: case I_SUB: case I_MUL: case I_DIV: case I_MOD:
+		case I_AND: case I_OR: case I_XOR: case I_SHL: case I_SHR:
+		case I_NEG: case I_INV:
+		case I_SLT: case I_SLE: case I_SEQ: case I_SNE: case I_SGT: case I_SGE:
+		case I_LAND: case I_LOR:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	inline static bool
+	ssa_op_is_set(INSTRUCTION_OP op)
+	{
+		switch (op)
+		{
+		case I_SLT: case I_SLE: case I_SEQ: case I_SNE: case I_SGT: case I_SGE:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	inline static bool
+	ssa_op_is_conditional(INSTRUCTION_OP op)
+	{
+		return op != I_BR && op_is_branch(op);
+	}
+
+	inline static SSA_Lattice
+	ssa_meet(SSA_Lattice a, SSA_Lattice b)
+	{
+		if (a.state == SSA_TOP)
+			return b;
+		if (b.state == SSA_TOP)
+			return a;
+		if (a.state == SSA_CONST && b.state == SSA_CONST && a.bits == b.bits)
+			return a;
+		return { SSA_BOTTOM, 0 };
+	}
+
+	// Arithmetic on constants of the given type, false if the result is left to runtime
+	// Integers wrap, division by zero and overflowing shifts are never folded
+	inline static bool
+	ssa_fold_binary(INSTRUCTION_OP op, Semantic_Expr::BASE type, uint64_t a, uint64_t b, uint64_t &out)
+	{
+		if (type == Semantic_Expr::INT || type == Semantic_Expr::UINT || type == Semantic_Expr::BOOL)
+		{
+			bool is_signed = type == Semantic_Expr::INT;
+			switch (op)
+			{
+			case I_ADD: out = a + b; return true;
+			case I_SUB: out = a - b; return true;
+			case I_MUL: out = a * b; return true;
+			case I_AND: case I_LAND: out = a & b; return true;
+			case I_OR:  case I_LOR:  out = a | b; return true;
+			case I_XOR: out = a ^ b; return true;
+
+			case I_DIV:
+			case I_MOD:
+				if (b == 0 || (is_signed && (int64_t)a == INT64_MIN && (int64_t)b == -1))
+					return false;
+				if (is_signed)
+					out = (uint64_t)(op == I_DIV ? (int64_t)a / (int64_t)b : (int64_t)a % (int64_t)b);
+				else
+					out = op == I_DIV ? a / b : a % b;
+				return true;
+
+			case I_SHL:
+			case I_SHR:
+				if (b >= 64)
+					return false;
+				if (op == I_SHL)
+					out = a << b;
+				else
+					out = is_signed ? (uint64_t)((int64_t)a >> b) : a >> b;
+				return true;
+
+			default:
+				return false;
+			}
+		}
+
+		if (type == Semantic_Expr::FLOAT)
+		{
+			auto x = std::bit_cast<double>(a), y = std::bit_cast<double>(b);
+			switch (op)
+			{
+			case I_ADD: out = std::bit_cast<uint64_t>(x + y); return true;
+			case I_SUB: out = std::bit_cast<uint64_t>(x - y); return true;
+			case I_MUL: out = std::bit_cast<uint64_t>(x * y); return true;
+			case I_DIV:
+				if (y == 0)
+					return false;
+				out = std::bit_cast<uint64_t>(x / y);
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	inline static bool
+	ssa_fold_unary(INSTRUCTION_OP op, Semantic_Expr::BASE type, uint64_t a, uint64_t &out)
+	{
+		switch (type)
+		{
+		case Semantic_Expr::INT:
+		case Semantic_Expr::UINT:
+			out = op == I_NEG ? 0 - a : ~a;
+			return true;
+		case Semantic_Expr::FLOAT:
+			if (op != I_NEG)
+				return false;
+			out = a ^ (1ull << 63);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	inline static bool
+	ssa_fold_compare(INSTRUCTION_OP op, Semantic_Expr::BASE type, uint64_t a, uint64_t b, bool &out)
+	{
+		auto compare = [&](auto x, auto y) {
+			switch (op)
+			{
+			case I_LOG_LT:  case I_SLT: out = x < y;  return true;
+			case I_LOG_LEQ: case I_SLE: out = x <= y; return true;
+			case I_LOG_EQ:  case I_SEQ: out = x == y; return true;
+			case I_LOG_NEQ: case I_SNE: out = x != y; return true;
+			case I_LOG_GT:  case I_SGT: out = x > y;  return true;
+			case I_LOG_GEQ: case I_SGE: out = x >= y; return true;
+			default: return false;
+			}
+		};
+
+		switch (type)
+		{
+		case Semantic_Expr::INT:	return compare((int64_t)a, (int64_t)b);
+		case Semantic_Expr::UINT:
+		case Semantic_Expr::BOOL:	return compare(a, b);
+		case Semantic_Expr::FLOAT:	return compare(std::bit_cast<double>(a), std::bit_cast<double>(b));
+		default:					return false;
+		}
+	}
+
+	// Variable of a temporary or symbol in graph, CFG_NONE if it stays in memory
+	inline static uint32_t
+	ssa_var(SSA &self, uint32_t graph, OPERAND_LOCATION loc, uint64_t id)
+	{
+		uint32_t *var = nullptr, *stamp = nullptr;
+		if (loc == OP_TMP)
+		{
+			var = &self.tmp_var[id];
+			stamp = &self.tmp_stamp[id];
+		}
+		else if (loc == OP_SYM && self.sym_owner[id] == graph)
+		{
+			var = &self.sym_var[id];
+			stamp = &self.sym_stamp[id];
+		}
+		else
+		{
+			return CFG_NONE;
+		}
+
+		if (*stamp != graph)
+		{
+			*stamp = graph;
+			*var = (uint32_t)self.var_is_tmp.size();
+			self.var_is_tmp.push_back(loc == OP_TMP);
+		}
+		return *var;
+	}
+
+	// Variable read by an operand, directly or as the index of an element
+	inline static uint32_t
+	ssa_operand_var(SSA &self, uint32_t graph, const Operand &opr)
+	{
+		switch (opr.loc)
+		{
+		case OP_TMP: return ssa_var(self, graph, OP_TMP, opr.value);
+		case OP_SYM: return ssa_var(self, graph, OP_SYM, opr.sym.idx);
+		case OP_ELEM: return ssa_var(self, graph, opr.index_loc, opr.value);
+		default: return CFG_NONE;
+		}
+	}
+
+	// Symbols are promoted when a single graph references them and no call can reenter it
+	// Arrays, procedures and symbols touched by procedures that call stay in memory
+	inline static void
+	ssa_find_owners(SSA &self)
+	{
+		auto &program = *self.program;
+
+		uint64_t max_tmp = 0;
+		uint32_t max_sym = 0;
+		for (size_t i = 0; i < program.operands.size(); i++)
+		{
+			auto &opr = program.operands[i];
+			if (opr.loc == OP_TMP || (opr.loc == OP_ELEM && opr.index_loc == OP_TMP))
+				max_tmp = std::max(max_tmp, opr.value);
+			if (opr.loc == OP_ELEM && opr.index_loc == OP_SYM)
+				max_sym = std::max(max_sym, (uint32_t)opr.value);
+			if (opr.loc == OP_SYM || opr.loc == OP_ELEM || opr.loc == OP_PARAM || opr.loc == OP_RET)
+				max_sym = std::max(max_sym, opr.sym.idx);
+		}
+		self.tmp_var.assign(max_tmp + 1, CFG_NONE);
+		self.tmp_stamp.assign(max_tmp + 1, CFG_NONE);
+		self.sym_owner.assign(max_sym + 1, CFG_NONE);
+		self.sym_var.assign(max_sym + 1, CFG_NONE);
+		self.sym_stamp.assign(max_sym + 1, CFG_NONE);
+
+		for (uint32_t g = 0; g < self.cfg.procs.size(); g++)
+		{
+			auto &graph = self.cfg.procs[g];
+
+			bool calls = false;
+			for (auto &block : graph.blocks)
+			{
+				for (auto i = block.begin; i < block.end; i++)
+					calls |= program.ops[i].op == I_CALL;
+			}
+
+			auto own = [&](uint32_t sym, bool promotable) {
+				auto &owner = self.sym_owner[sym];
+				if (promotable == false || (owner != CFG_NONE && owner != g))
+					owner = SSA_SHARED;
+				else
+					owner = g;
+			};
+
+			for (auto &block : graph.blocks)
+			{
+				for (auto i = block.begin; i < block.end; i++)
+				{
+					for (size_t k = 0; k < program.ops[i].operand_count; k++)
+					{
+						auto &opr = program.operands[3 * i + k];
+						switch (opr.loc)
+						{
+						case OP_SYM:
+							own(opr.sym.idx, g == 0 || calls == false);
+							break;
+						case OP_ELEM:
+							own(opr.sym.idx, false);
+							if (opr.index_loc == OP_SYM)
+								own((uint32_t)opr.value, g == 0 || calls == false);
+							break;
+						case OP_PARAM:
+						case OP_RET:
+							own(opr.sym.idx, false);
+							break;
+						default:
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Semi-pruned SSA, phis at the iterated dominance frontiers of the definitions of the variables
+	// that are live across blocks
+	inline static void
+	ssa_place_phis(SSA &self, const CFG &graph, uint32_t g)
+	{
+		auto &program = *self.program;
+		auto n = (uint32_t)graph.blocks.size();
+
+		self.var_is_tmp.clear();
+		for (auto b : graph.order)
+		{
+			auto &block = graph.blocks[b];
+			for (auto i = block.begin; i < block.end; i++)
+			{
+				auto op = program.ops[i];
+				for (size_t k = 0; k < op.operand_count; k++)
+				{
+					auto &opr = program.operands[3 * i + k];
+					if (k == 0 && ssa_op_writes(op.op) && (opr.loc == OP_TMP || opr.loc == OP_SYM))
+						self.defs[i] = ssa_operand_var(self, g, opr);
+					else
+						self.uses[3 * i + k] = ssa_operand_var(self, g, opr);
+				}
+			}
+		}
+		auto var_count = (uint32_t)self.var_is_tmp.size();
+
+		// Blocks defining each variable, and the variables read before their block writes them
+		self.var_global.assign(var_count, 0);
+		self.var_mark.assign(var_count, CFG_NONE);
+		self.pairs.clear();
+		for (auto b : graph.order)
+		{
+			auto &block = graph.blocks[b];
+			for (auto i = block.begin; i < block.end; i++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					if (auto v = self.uses[3 * i + k]; v != CFG_NONE && self.var_mark[v] != b)
+						self.var_global[v] = 1;
+				}
+				if (auto v = self.defs[i]; v != CFG_NONE && self.var_mark[v] != b)
+				{
+					self.var_mark[v] = b;
+					self.pairs.push_back({ v, b });
+				}
+			}
+		}
+		ssa_group(self.pairs, var_count, self.site_begin, self.sites);
+
+		// Dominance frontiers, walking up from the predecessors of each join to its immediate dominator
+		// The entry joins its back edges with the edge from outside
+		self.block_mark.assign(n, CFG_NONE);
+		self.pairs.clear();
+		for (auto b : graph.order)
+		{
+			auto &block = graph.blocks[b];
+			if (block.pred_count < 2 && (b != 0 || block.pred_count == 0))
+				continue;
+
+			for (uint32_t j = 0; j < block.pred_count; j++)
+			{
+				auto p = graph.preds[block.preds + j];
+				if (ssa_reachable(graph, p) == false)
+					continue;
+
+				for (auto runner = p; runner != block.idom; runner = graph.blocks[runner].idom)
+				{
+					if (self.block_mark[runner] != b)
+					{
+						self.block_mark[runner] = b;
+						self.pairs.push_back({ runner, b });
+					}
+				}
+			}
+		}
+		ssa_group(self.pairs, n, self.df_begin, self.df);
+
+		// Iterated dominance frontiers
+		self.block_mark.assign(n, CFG_NONE);	// has a phi of the variable
+		self.block_mark2.assign(n, CFG_NONE);	// defines the variable
+		self.pairs.clear();
+		for (uint32_t v = 0; v < var_count; v++)
+		{
+			if (self.var_global[v] == false)
+				continue;
+
+			self.work.clear();
+			for (auto s = self.site_begin[v]; s < self.site_begin[v + 1]; s++)
+			{
+				self.block_mark2[self.sites[s]] = v;
+				self.work.push_back(self.sites[s]);
+			}
+
+			while (self.work.empty() == false)
+			{
+				auto d = self.work.back();
+				self.work.pop_back();
+				for (auto f = self.df_begin[d]; f < self.df_begin[d + 1]; f++)
+				{
+					auto frontier = self.df[f];
+					if (self.block_mark[frontier] == v)
+						continue;
+
+					self.block_mark[frontier] = v;
+					self.pairs.push_back({ frontier, v });
+					if (self.block_mark2[frontier] != v)
+					{
+						self.block_mark2[frontier] = v;
+						self.work.push_back(frontier);
+					}
+				}
+			}
+		}
+
+		ssa_group(self.pairs, n, self.block_phis, self.phi_vars);
+
+		self.phis.resize(self.phi_vars.size());
+		uint32_t args = 0;
+		for (uint32_t b = 0; b < n; b++)
+		{
+			for (auto p = self.block_phis[b]; p < self.block_phis[b + 1]; p++)
+			{
+				self.phis[p] = { b, self.phi_vars[p], CFG_NONE, args };
+				args += graph.blocks[b].pred_count;
+			}
+		}
+		self.args.assign(args, CFG_NONE);
+	}
+
+	inline static uint32_t
+	ssa_new_value(SSA &self, uint32_t var, uint32_t def, SSA_STATE state)
+	{
+		self.values.push_back({ .state = state, .bits = 0, .var = var, .def = def });
+		return (uint32_t)self.values.size() - 1;
+	}
+
+	// Value of a variable at the current point of the renaming walk
+	inline static uint32_t
+	ssa_read(SSA &self, uint32_t var)
+	{
+		if (self.current[var] != CFG_NONE)
+			return self.current[var];
+
+		// Nothing is known of the values on entry
+		if (self.entry[var] == CFG_NONE)
+			self.entry[var] = ssa_new_value(self, var, CFG_NONE, SSA_BOTTOM);
+		return self.entry[var];
+	}
+
+	inline static void
+	ssa_write(SSA &self, uint32_t var, uint32_t value)
+	{
+		self.saved.push_back({ var, self.current[var] });
+		self.current[var] = value;
+	}
+
+	// Give every definition a value of its own walking the dominator tree, uses read the closest dominating one
+	inline static void
+	ssa_rename(SSA &self, const CFG &graph)
+	{
+		auto n = (uint32_t)graph.blocks.size();
+		auto var_count = (uint32_t)self.var_is_tmp.size();
+
+		self.values.clear();
+		self.current.assign(var_count, CFG_NONE);
+		self.entry.assign(var_count, CFG_NONE);
+		self.saved.clear();
+
+		self.pairs.clear();
+		for (auto b : graph.order)
+		{
+			if (b != 0)
+				self.pairs.push_back({ graph.blocks[b].idom, b });
+		}
+		ssa_group(self.pairs, n, self.child_begin, self.children);
+
+		// Frames enter a block, or leave it when they remember how much to restore
+		SSA_Pairs &frames = self.pairs;
+		frames.clear();
+		frames.push_back({ 0, CFG_NONE });
+		while (frames.empty() == false)
+		{
+			auto [b, restore] = frames.back();
+			frames.pop_back();
+
+			if (restore != CFG_NONE)
+			{
+				while (self.saved.size() > restore)
+				{
+					self.current[self.saved.back().first] = self.saved.back().second;
+					self.saved.pop_back();
+				}
+				continue;
+			}
+			frames.push_back({ b, (uint32_t)self.saved.size() });
+
+			// Phis of the entry also merge the values on entry, they are never constant
+			for (auto p = self.block_phis[b]; p < self.block_phis[b + 1]; p++)
+			{
+				auto &phi = self.phis[p];
+				phi.value = ssa_new_value(self, phi.var, p | SSA_PHI, b == 0 ? SSA_BOTTOM : SSA_TOP);
+				ssa_write(self, phi.var, phi.value);
+			}
+
+			auto &block = graph.blocks[b];
+			for (auto i = block.begin; i < block.end; i++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					if (auto &use = self.uses[3 * i + k]; use != CFG_NONE)
+						use = ssa_read(self, use);
+				}
+				if (auto &def = self.defs[i]; def != CFG_NONE)
+				{
+					auto var = def;
+					def = ssa_new_value(self, var, i, SSA_TOP);
+					ssa_write(self, var, def);
+				}
+			}
+
+			for (auto s : block.succs)
+			{
+				if (s == CFG_NONE)
+					continue;
+
+				auto &succ = graph.blocks[s];
+				uint32_t j = 0;
+				while (graph.preds[succ.preds + j] != b)
+					j++;
+
+				for (auto p = self.block_phis[s]; p < self.block_phis[s + 1]; p++)
+					self.args[self.phis[p].args + j] = ssa_read(self, self.phis[p].var);
+			}
+
+			for (auto c = self.child_begin[b]; c < self.child_begin[b + 1]; c++)
+				frames.push_back({ self.children[c], CFG_NONE });
+		}
+
+		// Def-use chains
+		self.pairs.clear();
+		for (auto b : graph.order)
+		{
+			auto &block = graph.blocks[b];
+			for (auto i = block.begin; i < block.end; i++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					if (auto v = self.uses[3 * i + k]; v != CFG_NONE)
+						self.pairs.push_back({ v, i });
+				}
+			}
+			for (auto p = self.block_phis[b]; p < self.block_phis[b + 1]; p++)
+			{
+				for (uint32_t j = 0; j < block.pred_count; j++)
+				{
+					if (auto v = self.args[self.phis[p].args + j]; v != CFG_NONE)
+						self.pairs.push_back({ v, p | SSA_PHI });
+				}
+			}
+		}
+		ssa_group(self.pairs, (uint32_t)self.values.size(), self.use_begin, self.use_list);
+	}
+
+	inline static bool
+	ssa_edge_executable(const SSA &self, const CFG &graph, uint32_t from, uint32_t to)
+	{
+		auto k = graph.blocks[from].succs[0] == to ? 0 : 1;
+		return self.executable_edge[2 * from + k];
+	}
+
+	inline static SSA_Lattice
+	ssa_operand(const SSA &self, size_t i, size_t k)
+	{
+		auto &opr = self.program->operands[3 * i + k];
+		if (opr.loc == OP_IMM)
+			return { SSA_CONST, opr.value };
+
+		auto v = self.uses[3 * i + k];
+		if ((opr.loc == OP_TMP || opr.loc == OP_SYM) && v != CFG_NONE)
+			return { self.values[v].state, self.values[v].bits };
+
+		return { SSA_BOTTOM, 0 };
+	}
+
+	// Value written by instruction i given what is known of its operands
+	inline static SSA_Lattice
+	ssa_evaluate(const SSA &self, size_t i)
+	{
+		auto [op, operand_count, type] = self.program->ops[i];
+		if (op == I_MOV)
+			return ssa_operand(self, i, 1);
+
+		uint64_t bits = 0;
+		if (op == I_NEG || op == I_INV)
+		{
+			auto a = ssa_operand(self, i, 1);
+			if (a.state != SSA_CONST)
+				return a;
+			if (ssa_fold_unary(op, (Semantic_Expr::BASE)type, a.bits, bits))
+				return { SSA_CONST, bits };
+			return { SSA_BOTTOM, 0 };
+		}
+
+		auto a = ssa_operand(self, i, 1), b = ssa_operand(self, i, 2);
+		if (op == I_LAND || op == I_LOR)
+		{
+			// Booleans are 0 or 1, either operand may decide alone
+			uint64_t decides = op == I_LOR;
+			if ((a.state == SSA_CONST && a.bits == decides) || (b.state == SSA_CONST && b.bits == decides))
+				return { SSA_CONST, decides };
+		}
+
+		if (a.state == SSA_BOTTOM || b.state == SSA_BOTTOM)
+			return { SSA_BOTTOM, 0 };
+		if (a.state == SSA_TOP || b.state == SSA_TOP)
+			return { SSA_TOP, 0 };
+		if (ssa_op_is_set(op))
+		{
+			bool set = false;
+			if (ssa_fold_compare(op, (Semantic_Expr::BASE)type, a.bits, b.bits, set))
+				return { SSA_CONST, set };
+			return { SSA_BOTTOM, 0 };
+		}
+		if (ssa_fold_binary(op, (Semantic_Expr::BASE)type, a.bits, b.bits, bits))
+			return { SSA_CONST, bits };
+		return { SSA_BOTTOM, 0 };
+	}
+
+	// Ways out of the conditional branch i given what is known of its operands
+	inline static uint8_t
+	ssa_evaluate_branch(const SSA &self, size_t i)
+	{
+		auto [op, operand_count, type] = self.program->ops[i];
+		if (op == I_BZ || op == I_BNZ)
+		{
+			// Branches test the bits, which may also be a negative zero float
+			auto a = ssa_operand(self, i, 1);
+			if (a.state == SSA_TOP)
+				return 0;
+			if (a.state == SSA_BOTTOM || a.bits == 1ull << 63)
+				return SSA_TAKEN | SSA_FALLS;
+			return (a.bits == 0) == (op == I_BZ) ? SSA_TAKEN : SSA_FALLS;
+		}
+
+		auto a = ssa_operand(self, i, 1), b = ssa_operand(self, i, 2);
+		if (a.state == SSA_BOTTOM || b.state == SSA_BOTTOM)
+			return SSA_TAKEN | SSA_FALLS;
+		if (a.state == SSA_TOP || b.state == SSA_TOP)
+			return 0;
+
+		bool taken = false;
+		if (ssa_fold_compare(op, (Semantic_Expr::BASE)type, a.bits, b.bits, taken) == false)
+			return SSA_TAKEN | SSA_FALLS;
+		return taken ? SSA_TAKEN : SSA_FALLS;
+	}
+
+	inline static void
+	ssa_lower(SSA &self, uint32_t v, SSA_Lattice lattice)
+	{
+		auto &value = self.values[v];
+		auto next = ssa_meet({ value.state, value.bits }, lattice);
+		if (next.state != value.state)
+		{
+			value.state = next.state;
+			value.bits = next.bits;
+			self.value_work.push_back(v);
+		}
+	}
+
+	// Whether block b ends with a branch to the block right after it, which leaves a single edge
+	inline static bool
+	ssa_branches_to_next(const CFG &graph, uint32_t b)
+	{
+		return b + 1 < graph.blocks.size() && graph.blocks[b].succs[0] == b + 1;
+	}
+
+	inline static void
+	ssa_mark_edge(SSA &self, const CFG &graph, uint32_t b, uint32_t k)
+	{
+		if (graph.blocks[b].succs[k] == CFG_NONE || self.executable_edge[2 * b + k])
+			return;
+		self.executable_edge[2 * b + k] = 1;
+		self.flow_work.push_back(2 * b + k);
+	}
+
+	inline static void
+	ssa_visit_instruction(SSA &self, const CFG &graph, uint32_t i)
+	{
+		if (self.defs[i] != CFG_NONE)
+			ssa_lower(self, self.defs[i], ssa_evaluate(self, i));
+
+		auto b = self.block_of[i];
+		auto &block = graph.blocks[b];
+		if (i + 1 != block.end)
+			return;
+
+		auto op = self.program->ops[i].op;
+		if (op == I_BR)
+		{
+			ssa_mark_edge(self, graph, b, 0);
+		}
+		else if (ssa_op_is_conditional(op))
+		{
+			// Falling off the end of the program has no edge
+			auto ways = ssa_evaluate_branch(self, i);
+			self.branch_ways[b] |= ways;
+			if (ways & SSA_TAKEN)
+				ssa_mark_edge(self, graph, b, 0);
+			if ((ways & SSA_FALLS) && ssa_branches_to_next(graph, b))
+				ssa_mark_edge(self, graph, b, 0);
+			else if (ways & SSA_FALLS)
+				ssa_mark_edge(self, graph, b, 1);
+		}
+		else if (op != I_RET)
+		{
+			ssa_mark_edge(self, graph, b, 1);
+		}
+	}
+
+	inline static void
+	ssa_visit_phi(SSA &self, const CFG &graph, uint32_t p)
+	{
+		auto &phi = self.phis[p];
+		if (phi.block == 0)
+			return;
+
+		auto &block = graph.blocks[phi.block];
+		SSA_Lattice lattice = { SSA_TOP, 0 };
+		for (uint32_t j = 0; j < block.pred_count; j++)
+		{
+			if (ssa_edge_executable(self, graph, graph.preds[block.preds + j], phi.block))
+			{
+				auto &arg = self.values[self.args[phi.args + j]];
+				lattice = ssa_meet(lattice, { arg.state, arg.bits });
+			}
+		}
+		ssa_lower(self, phi.value, lattice);
+	}
+
+	// Sparse conditional constant propagation, Wegman and Zadeck
+	// Blocks are only evaluated once an edge into them is found executable, so values flowing from
+	// branches that are never taken do not spoil the constants
+	inline static void
+	ssa_propagate(SSA &self, const CFG &graph)
+	{
+		auto n = (uint32_t)graph.blocks.size();
+		self.executable_block.assign(n, 0);
+		self.executable_edge.assign(2 * n, 0);
+		self.branch_ways.assign(n, 0);
+		self.flow_work.clear();
+		self.value_work.clear();
+
+		self.executable_block[0] = 1;
+		for (auto i = graph.blocks[0].begin; i < graph.blocks[0].end; i++)
+			ssa_visit_instruction(self, graph, i);
+
+		while (self.flow_work.empty() == false || self.value_work.empty() == false)
+		{
+			while (self.flow_work.empty() == false)
+			{
+				auto edge = self.flow_work.back();
+				self.flow_work.pop_back();
+
+				auto s = graph.blocks[edge / 2].succs[edge % 2];
+				for (auto p = self.block_phis[s]; p < self.block_phis[s + 1]; p++)
+					ssa_visit_phi(self, graph, p);
+
+				if (self.executable_block[s] == false)
+				{
+					self.executable_block[s] = 1;
+					for (auto i = graph.blocks[s].begin; i < graph.blocks[s].end; i++)
+						ssa_visit_instruction(self, graph, i);
+				}
+			}
+
+			while (self.value_work.empty() == false)
+			{
+				auto v = self.value_work.back();
+				self.value_work.pop_back();
+
+				for (auto u = self.use_begin[v]; u < self.use_begin[v + 1]; u++)
+				{
+					auto use = self.use_list[u];
+					if (use & SSA_PHI)
+					{
+						if (self.executable_block[self.phis[use & ~SSA_PHI].block])
+							ssa_visit_phi(self, graph, use & ~SSA_PHI);
+					}
+					else if (self.executable_block[self.block_of[use]])
+					{
+						ssa_visit_instruction(self, graph, use);
+					}
+				}
+			}
+		}
+	}
+
+	// Drop instruction i, a label on it stays behind on a NOP as branches may still target it
+	inline static void
+	ssa_remove(SSA &self, uint32_t i)
+	{
+		auto &program = *self.program;
+		if (program.labels[i].type != Label::NONE)
+		{
+			program.ops[i] = { I_NOP, 0, Semantic_Expr::VOID };
+			for (size_t k = 0; k < 3; k++)
+				program.operands[3 * i + k] = {};
+		}
+		else
+		{
+			self.keep[i] = 0;
+		}
+
+		self.defs[i] = CFG_NONE;
+		for (size_t k = 0; k < 3; k++)
+			self.uses[3 * i + k] = CFG_NONE;
+	}
+
+	inline static void
+	ssa_mark_live(SSA &self, uint32_t v)
+	{
+		if (v != CFG_NONE && self.live[v] == false)
+		{
+			self.live[v] = 1;
+			self.work.push_back(v);
+		}
+	}
+
+	// Substitute the constants, fold the decided branches and drop the dead code
+	// Out of SSA every version of a variable goes back to its name, copies never have to be inserted
+	// as uses only ever get replaced by constants and no value outlives the ones it was renamed from
+	inline static void
+	ssa_rewrite(SSA &self, const CFG &graph)
+	{
+		auto &program = *self.program;
+		auto n = (uint32_t)graph.blocks.size();
+
+		for (uint32_t b = 0; b < n; b++)
+		{
+			auto &block = graph.blocks[b];
+			if (self.executable_block[b] == false)
+			{
+				// Procedures stay delimited, the RET ending one that never returns is kept with its label
+				for (auto i = block.begin; i < block.end; i++)
+				{
+					if (auto type = program.labels[i].type; type != Label::PROC && type != Label::END_PROC)
+						self.keep[i] = 0;
+				}
+				continue;
+			}
+
+			for (auto i = block.begin; i < block.end; i++)
+			{
+				if (auto d = self.defs[i]; d != CFG_NONE && self.values[d].state == SSA_CONST)
+				{
+					program.ops[i].op = I_MOV;
+					program.ops[i].operand_count = 2;
+					program.operands[3 * i + 1] = Operand{ self.values[d].bits };
+					program.operands[3 * i + 2] = {};
+					self.uses[3 * i + 1] = self.uses[3 * i + 2] = CFG_NONE;
+					continue;
+				}
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					auto v = self.uses[3 * i + k];
+					if (v == CFG_NONE || self.values[v].state != SSA_CONST)
+						continue;
+
+					auto &opr = program.operands[3 * i + k];
+					if (opr.loc == OP_ELEM)
+					{
+						opr.index_loc = OP_IMM;
+						opr.value = self.values[v].bits;
+					}
+					else
+					{
+						opr = Operand{ self.values[v].bits };
+					}
+					self.uses[3 * i + k] = CFG_NONE;
+				}
+			}
+
+			auto last = block.end - 1;
+			if (ssa_op_is_conditional(program.ops[last].op) && self.branch_ways[b] != (SSA_TAKEN | SSA_FALLS))
+			{
+				// A branch to the next block goes there either way
+				if (self.branch_ways[b] == SSA_TAKEN && ssa_branches_to_next(graph, b) == false)
+				{
+					program.ops[last] = { I_BR, 1, Semantic_Expr::VOID };
+					program.operands[3 * last + 1] = program.operands[3 * last + 2] = {};
+					self.uses[3 * last + 1] = self.uses[3 * last + 2] = CFG_NONE;
+				}
+				else if (self.branch_ways[b] != 0)
+				{
+					ssa_remove(self, last);
+				}
+			}
+		}
+
+		// Temporaries nothing reads anymore, marking from the instructions with effects
+		self.live.assign(self.values.size(), 0);
+		self.work.clear();
+		auto essential = [&](uint32_t i) {
+			auto d = self.defs[i];
+			return self.keep[i] && (d == CFG_NONE || self.var_is_tmp[self.values[d].var] == false);
+		};
+		for (auto b : graph.order)
+		{
+			if (self.executable_block[b] == false)
+				continue;
+
+			for (auto i = graph.blocks[b].begin; i < graph.blocks[b].end; i++)
+			{
+				if (essential(i))
+				{
+					for (size_t k = 0; k < 3; k++)
+						ssa_mark_live(self, self.uses[3 * i + k]);
+				}
+			}
+		}
+
+		while (self.work.empty() == false)
+		{
+			auto &value = self.values[self.work.back()];
+			self.work.pop_back();
+
+			if (value.def == CFG_NONE)
+				continue;
+
+			if (value.def & SSA_PHI)
+			{
+				auto &phi = self.phis[value.def & ~SSA_PHI];
+				auto &block = graph.blocks[phi.block];
+				for (uint32_t j = 0; j < block.pred_count; j++)
+				{
+					if (ssa_edge_executable(self, graph, graph.preds[block.preds + j], phi.block))
+						ssa_mark_live(self, self.args[phi.args + j]);
+				}
+			}
+			else
+			{
+				for (size_t k = 0; k < 3; k++)
+					ssa_mark_live(self, self.uses[3 * value.def + k]);
+			}
+		}
+
+		for (auto b : graph.order)
+		{
+			if (self.executable_block[b] == false)
+				continue;
+
+			for (auto i = graph.blocks[b].begin; i < graph.blocks[b].end; i++)
+			{
+				if (auto d = self.defs[i]; d != CFG_NONE && essential(i) == false && self.live[d] == false)
+					ssa_remove(self, i);
+			}
+		}
+	}
+
+	size_t
+	ssa_optimize(Program &program)
+	{
+		SSA self = {};
+		self.program = &program;
+		cfg_build(self.cfg, program);
+
+		auto count = program.count();
+		self.defs.assign(count, CFG_NONE);
+		self.uses.assign(3 * count, CFG_NONE);
+		self.block_of.assign(count, CFG_NONE);
+		self.keep.assign(count, 1);
+
+		ssa_find_owners(self);
+		for (uint32_t g = 0; g < self.cfg.procs.size(); g++)
+		{
+			auto &graph = self.cfg.procs[g];
+			for (uint32_t b = 0; b < graph.blocks.size(); b++)
+			{
+				for (auto i = graph.blocks[b].begin; i < graph.blocks[b].end; i++)
+					self.block_of[i] = b;
+			}
+
+			ssa_place_phis(self, graph, g);
+			ssa_rename(self, graph);
+			ssa_propagate(self, graph);
+			ssa_rewrite(self, graph);
+		}
+
+		return program_compact(program, self.keep);
+	}
+}
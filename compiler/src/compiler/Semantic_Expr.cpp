@@ -6,21 +6,129 @@
 
 namespace s22
 {
+	inline static uint64_t
+	type_hash(Semantic_Expr::BASE base, uint64_t array, const Buf<Semantic_Expr> *parameters, Semantic_Expr return_type)
+	{
+		// FNV-1a over the type's structure
+		uint64_t hash = 14695981039346656037ull;
+		auto mix = [&hash](uint64_t v) { hash = (hash ^ v) * 1099511628211ull; };
+
+		mix(base);
+		mix(array);
+		if (parameters)
+		{
+			mix(return_type.idx);
+			mix(parameters->count);
+			for (const auto &param : *parameters)
+				mix(param.idx);
+		}
+		return hash;
+	}
+
+	inline static bool
+	type_matches(const Type_Info &info, Semantic_Expr::BASE base, uint64_t array, const Buf<Semantic_Expr> *parameters, Semantic_Expr return_type)
+	{
+		if (info.base != base || info.array != array)
+			return false;
+
+		if (parameters == nullptr)
+			return info.procedure == nullptr;
+
+		if (info.procedure == nullptr || info.procedure->return_type != return_type)
+			return false;
+
+		return info.procedure->parameters == *parameters;
+	}
+
+	inline static Semantic_Expr
+	type_intern(Type_Table *self, Semantic_Expr::BASE base, uint64_t array, const Buf<Semantic_Expr> *parameters, Semantic_Expr return_type)
+	{
+		auto hash = type_hash(base, array, parameters, return_type);
+
+		auto [begin, end] = self->lookup.equal_range(hash);
+		for (auto it = begin; it != end; it++)
+		{
+			if (type_matches(self->types[it->second], base, array, parameters, return_type))
+				return Semantic_Expr{ .idx = it->second };
+		}
+
+		Type_Info info = { .base = base, .array = array };
+		if (parameters)
+		{
+			auto proc = alloc<Procedure>();
+			proc->parameters = Buf<Semantic_Expr>::make(parameters->count);
+			if (parameters->count > 0)
+				::memcpy(proc->parameters.data, parameters->data, parameters->count * sizeof(Semantic_Expr));
+			proc->return_type = return_type;
+			info.procedure = proc;
+		}
+
+		Semantic_Expr self_expr = { .idx = (uint32_t)self->types.size() };
+		self->types.push_back(info);
+		self->lookup.emplace(hash, self_expr.idx);
+		return self_expr;
+	}
+
+	// Seeds base types so that their index matches their BASE
+	inline static Type_Table *
+	type_table_seeded()
+	{
+		auto self = type_table_instance();
+		if (self->types.empty())
+		{
+			for (auto base : { Semantic_Expr::VOID, Semantic_Expr::PROC, Semantic_Expr::INT, Semantic_Expr::UINT, Semantic_Expr::FLOAT, Semantic_Expr::BOOL })
+			{
+				self->types.push_back({ .base = base });
+				self->lookup.emplace(type_hash(base, 0, nullptr, {}), (uint32_t)base);
+			}
+		}
+		return self;
+	}
+
+	void
+	type_table_clear(Type_Table *self)
+	{
+		self->lookup.clear();
+		self->types.clear();
+	}
+
+	const Type_Info &
+	semexpr_info(Semantic_Expr semexpr)
+	{
+		auto self = type_table_seeded();
+		if (semexpr.idx >= self->types.size())
+			return self->types[Semantic_Expr::VOID];
+		return self->types[semexpr.idx];
+	}
+
+	Semantic_Expr
+	semexpr_array_of(Semantic_Expr::BASE base, uint64_t size)
+	{
+		return type_intern(type_table_seeded(), base, size, nullptr, {});
+	}
+
+	Semantic_Expr
+	semexpr_proc(const Buf<Semantic_Expr> &parameters, Semantic_Expr return_type)
+	{
+		return type_intern(type_table_seeded(), Semantic_Expr::PROC, 0, &parameters, return_type);
+	}
+
 	bool
-	semexpr_allows_arithmetic(const Semantic_Expr &semexpr)
+	semexpr_allows_arithmetic(Semantic_Expr semexpr)
 	{
 		// Arrays are different from array access Expr{arr} != Expr{arr[i]}
-		return (semexpr.array || semexpr.procedure) == false;
+		auto &info = semexpr_info(semexpr);
+		return (info.array || info.procedure) == false;
 	}
 
 	bool
-	semexpr_is_integral(const Semantic_Expr &semexpr)
+	semexpr_is_integral(Semantic_Expr semexpr)
 	{
 		return semexpr == SEMEXPR_INT || semexpr == SEMEXPR_UINT || semexpr == SEMEXPR_BOOL;
 	}
 
 	void
-	semexpr_print(const Semantic_Expr &semexpr, FILE *out)
+	semexpr_print(Semantic_Expr semexpr, FILE *out)
 	{
 		auto fmt = std::format("{}", semexpr);
 		fprintf(out, "%s", fmt.data());
@@ -29,33 +137,33 @@ namespace s22
 	Result<Semantic_Expr>
 	semexpr_literal(Scope *scope, Literal lit, Semantic_Expr::BASE base)
 	{
-		return Semantic_Expr{ .base = base, .is_literal = true };
+		return Semantic_Expr{ .idx = base, .is_literal = true };
 	}
 
 	Result<Semantic_Expr>
-	semexpr_id(Scope *scope, const char *id)
+	semexpr_id(Scope *scope, Str_Id id)
 	{
 		auto sym = scope_get_sym(scope, id);
 		if (sym == nullptr)
-			return Error{ "undeclared identifier" };
+			return Error{ E_UNDECLARED_IDENTIFIER };
 		sym->is_used = true;
 
 		return sym->type;
 	}
 
 	Result<Semantic_Expr>
-	semexpr_assign(Scope *scope, const char *id, const Parse_Unit &right, Asn op)
+	semexpr_assign(Scope *scope, Str_Id id, const Parse_Unit &right, Asn op)
 	{
 		auto sym = scope_get_sym(scope, id);
 		if (sym == nullptr)
-			return Error{ "undeclared identifier" };
+			return Error{ E_UNDECLARED_IDENTIFIER };
 		sym->is_used = true;
 
 		if (sym->type != right.semexpr)
-			return Error{ "type mismatch" };
+			return Error{ E_TYPE_MISMATCH };
 
-		if (sym->is_constant || sym->type.procedure)
-			return Error{ "assignment to constant" };
+		if (sym->is_constant || semexpr_procedure(sym->type))
+			return Error{ E_ASSIGNMENT_TO_CONSTANT };
 
 		sym->is_set = true;
 
@@ -66,7 +174,7 @@ namespace s22
 	semexpr_array_assign(Scope *scope, const Parse_Unit &left, const Parse_Unit &right, Asn op)
 	{
 		if (left.semexpr != right.semexpr)
-			return Error{ "type mismatch" };
+			return Error{ E_TYPE_MISMATCH };
 
 		return left.semexpr;
 	}
@@ -75,21 +183,21 @@ namespace s22
 	semexpr_binary(Scope *scope, const Parse_Unit &left, const Parse_Unit &right, Bin op)
 	{
 		if (semexpr_allows_arithmetic(left.semexpr) == false)
-			return Error{ left.loc, "invalid operand" };
+			return Error{ left.loc, E_INVALID_OPERAND };
 
 		// Operand specific rules
 		switch (op)
 		{
 		case Bin::SHL: case Bin::SHR: case Bin::MOD:
 			if (semexpr_is_integral(right.semexpr) == false)
-				return Error{ right.loc, "invalid operand" };
+				return Error{ right.loc, E_INVALID_OPERAND };
 
 		case Bin::L_AND: case Bin::L_OR:
 			break; // both types are cast to boolean
 
 		default:
 			if (left.semexpr != right.semexpr)
-				return Error{ "type mismatch" };
+				return Error{ E_TYPE_MISMATCH };
 		}
 
 		switch (op)
@@ -122,7 +230,7 @@ namespace s22
 	semexpr_unary(Scope *scope, const Parse_Unit &right, Uny op)
 	{
 		if (semexpr_allows_arithmetic(right.semexpr) == false)
-			return Error{ right.loc, "invalid operand" };
+			return Error{ right.loc, E_INVALID_OPERAND };
 
 		if (op != Uny::NOT)
 		{
@@ -135,45 +243,45 @@ namespace s22
 	}
 
 	Result<Semantic_Expr>
-	semexpr_array_access(Scope *scope, const char *id, const Parse_Unit &expr)
+	semexpr_array_access(Scope *scope, Str_Id id, const Parse_Unit &expr)
 	{
 		auto sym = scope_get_sym(scope, id);
 		if (sym == nullptr)
-			return Error{ "undeclared identifier" };
+			return Error{ E_UNDECLARED_IDENTIFIER };
 		sym->is_used = true;
 
-		if (sym->type.array == false)
-			return Error{ "type cannot be indexed" };
+		if (semexpr_array(sym->type) == 0)
+			return Error{ E_NOT_INDEXABLE };
 
 		if (semexpr_is_integral(expr.semexpr) == false)
-			return Error{ expr.loc, "invalid index" };
-
-		Semantic_Expr self = sym->type;
-		self.array = 0;
+			return Error{ expr.loc, E_INVALID_INDEX };
 
+		// Element type, base types are seeded at their BASE
+		Semantic_Expr self = { .idx = semexpr_base(sym->type) };
 		return self;
 	}
 
 	Result<Semantic_Expr>
-	semexpr_proc_call(Scope *scope, const char *id, const Buf<Parse_Unit> &params)
+	semexpr_proc_call(Scope *scope, Str_Id id, const Buf<Parse_Unit> &params)
 	{
 		auto sym = scope_get_sym(scope, id);
 		if (sym == nullptr)
-			return Error{ "undeclared identifier" };
+			return Error{ E_UNDECLARED_IDENTIFIER };
 		sym->is_used = true;
 
-		if (sym->type.procedure == false)
-			return Error{ "type is not callable" };
+		auto proc = semexpr_procedure(sym->type);
+		if (proc == nullptr)
+			return Error{ E_NOT_CALLABLE };
 
-		if (sym->type.procedure->parameters.count != params.count)
-			return Error{ "invalid argument count" };
+		if (proc->parameters.count != params.count)
+			return Error{ E_INVALID_ARGUMENT_COUNT };
 
 		for (size_t i = 0; i < params.count; i++)
 		{
-			if (params[i].semexpr != sym->type.procedure->parameters[i])
-				return Error{ params[i].loc, "invalid argument" };
+			if (params[i].semexpr != proc->parameters[i])
+				return Error{ params[i].loc, E_INVALID_ARGUMENT };
 		}
 
-		return sym->type.procedure->return_type;
+		return proc->return_type;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "compiler/Source.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#if !defined(_WIN32)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace s22
+{
+	// Read the whole file into the heap, used where mapping is not available
+	inline static Result<Source_Buffer>
+	source_read(const char *path)
+	{
+		auto f = fopen(path, "rb");
+		if (f == nullptr)
+			return Error{E_FILE_READ};
+		s22_defer { fclose(f); };
+
+		fseek(f, 0, SEEK_END);
+		auto fsize = ftell(f);
+		rewind(f);
+
+		if (fsize < 0)
+			return Error{E_FILE_READ};
+
+		if ((size_t)fsize > SOURCE_SIZE_MAX)
+			return Error{E_FILE_TOO_LARGE};
+
+		auto data = (char *)::malloc(fsize + LEXER_PADDING);
+		if (data == nullptr)
+			return Error{E_FILE_READ};
+
+		Source_Buffer self = { .data = data, .size = fread(data, 1, fsize, f) };
+		memset(data + self.size, 0, LEXER_PADDING);
+		return self;
+	}
+
+	Result<Source_Buffer>
+	source_load(const char *path)
+	{
+	#if defined(_WIN32)
+		return source_read(path);
+	#else
+		auto fd = open(path, O_RDONLY);
+		if (fd == -1)
+			return Error{E_FILE_READ};
+		s22_defer { close(fd); };
+
+		struct stat st = {};
+		if (fstat(fd, &st) == -1)
+			return Error{E_FILE_READ};
+
+		// Pipes and devices cannot be mapped
+		if (S_ISREG(st.st_mode) == false)
+			return source_read(path);
+
+		size_t size = st.st_size;
+		if (size > SOURCE_SIZE_MAX)
+			return Error{E_FILE_TOO_LARGE};
+
+		// Reserve room for the file and its padding, then map the file over the start of it
+		// The rest of the file's last page reads as zeros, a file ending on a page boundary gets its padding from the anonymous page after it
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t mapped = (size + LEXER_PADDING + page - 1) / page * page;
+
+		auto base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return Error{E_FILE_READ};
+
+		if (size != 0)
+		{
+			if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+			{
+				munmap(base, mapped);
+				return source_read(path);
+			}
+
+			// The lexer walks the code front to back
+			madvise(base, size, MADV_SEQUENTIAL);
+		}
+
+		Source_Buffer self = { .data = (char *)base, .size = size, .mapped = mapped };
+		return self;
+	#endif
+	}
+
+	void
+	source_free(Source_Buffer &self)
+	{
+	#if !defined(_WIN32)
+		if (self.mapped != 0)
+		{
+			munmap(self.data, self.mapped);
+			self = {};
+			return;
+		}
+	#endif
+
+		::free(self.data);
+		self = {};
+	}
+}
@@ -5,46 +5,94 @@
 
 namespace s22
 {
-	template<typename T>
-	inline static T *
-	push_entry(Scope *self)
+	inline static uint32_t
+	index_slot(Str_Id id, uint32_t cap)
 	{
-		// NOTE: If symbol pointers change, the code breaks, as some data is hashed by pointers
-		// So we reserve size beforehand to ensure the data isn't moved
-		if (self->table.empty())
-			self->table.reserve(1024);
+		// Multiplicative hashing, ids are dense so the low bits spread well
+		return (id.idx * 2654435769u) & (cap - 1);
+	}
+
+	// Returns the slot of the identifier, nullptr if not found
+	// Adds the number of slots inspected to probes
+	inline static const Scope_Index::Slot *
+	index_find(const Scope_Index &self, Str_Id id, size_t &probes)
+	{
+		if (self.count == 0)
+			return nullptr;
 
-		self->table.push_back(T{});
-		return &std::get<T>(self->table.back());
+		for (uint32_t i = index_slot(id, self.cap);; i = (i + 1) & (self.cap - 1))
+		{
+			probes++;
+			auto &slot = self.slots[i];
+			if (slot.id == id)
+				return &slot;
+			if (bool(slot.id) == false)
+				return nullptr;
+		}
 	}
 
-	Result<Symbol *>
-	scope_add_decl(Scope *self, const Symbol &symbol)
+	inline static const Scope_Index::Slot *
+	index_find(const Scope_Index &self, Str_Id id)
 	{
-		// Try to find duplicate
-		for (const auto &entry : self->table)
+		size_t probes = 0;
+		return index_find(self, id, probes);
+	}
+
+	inline static void
+	index_insert(Scope_Index &self, Symbol *sym, uint32_t entry)
+	{
+		// Grow at 75% load
+		if ((self.count + 1) * 4 > self.cap * 3)
 		{
-			if (std::holds_alternative<Symbol>(entry))
+			auto old = self;
+			self.cap = std::max(old.cap * 2, 8u);
+			self.slots = alloc<Scope_Index::Slot>(self.cap);
+			self.count = 0;
+
+			for (uint32_t i = 0; i < old.cap; i++)
 			{
-				auto &dup = std::get<Symbol>(entry);
-				if (dup.id == symbol.id)
-					return Error{symbol.defined_at, "duplicate identifier at {}", dup.defined_at};
+				if (old.slots[i].id)
+					index_insert(self, old.slots[i].sym, old.slots[i].entry);
 			}
 		}
 
-		auto sym = push_entry<Symbol>(self);
+		auto i = index_slot(sym->id, self.cap);
+		while (self.slots[i].id)
+			i = (i + 1) & (self.cap - 1);
+
+		self.slots[i] = { sym->id, entry, sym };
+		self.count++;
+	}
+
+	inline static Symbol *
+	push_symbol(Scope *self, const Symbol &symbol)
+	{
+		auto sym = alloc<Symbol>();
 		*sym = symbol;
+
+		index_insert(self->index, sym, (uint32_t)self->table.count);
+		arena_list_push(self->table, { .sym = sym });
 		return sym;
 	}
 
+	Result<Symbol *>
+	scope_add_decl(Scope *self, const Symbol &symbol)
+	{
+		// Try to find duplicate
+		if (auto dup = index_find(self->index, symbol.id))
+			return Error{symbol.defined_at, E_DUPLICATE_IDENTIFIER, dup->sym->defined_at};
+
+		return push_symbol(self, symbol);
+	}
+
 	Result<Symbol *>
 	scope_add_decl(Scope *self, const Symbol &symbol, const Parse_Unit &expr)
 	{
 		if (expr.err)
-			return expr.err;
+			return diag_get(expr.err);
 
 		if (symbol.type != expr.semexpr)
-			return Error{expr.loc, "type mismatch"};
+			return Error{expr.loc, E_TYPE_MISMATCH};
 
 		auto [sym, sym_err] = scope_add_decl(self, symbol);
 		if (sym_err)
@@ -55,41 +103,29 @@ namespace s22
 	}
 
 	Result<Symbol *>
-	scope_add_decl_proc(Scope *&self, const Symbol &symbol)
+	scope_add_decl_proc(Scope *self, const Symbol &symbol)
 	{
 		// Entry point is a scope where all parameters are defined
-		// self = &table.back();
-		// Pop scope temporarily
-		s22_assert_msg(self == &std::get<Scope>(self->parent_scope->table.back()),
-			"scope isn't last in its parent's table");
-		
-		auto inner_scope = std::move(*self);
-		self = inner_scope.parent_scope;
+		// self = table.back().scope
+		auto inner = self;
+		auto parent = inner->parent_scope;
+		s22_assert_msg(inner == parent->table.back().scope, "scope isn't last in its parent's table");
 
 		// Try to find duplicate
-		for (const auto &entry : self->table)
-		{
-			if (std::holds_alternative<Symbol>(entry))
-			{
-				auto &dup = std::get<Symbol>(entry);
-				if (dup.id == symbol.id)
-					return Error{symbol.defined_at, "duplicate identifier at {}", dup.defined_at};
-			}
-		}
+		if (auto dup = index_find(parent->index, symbol.id))
+			return Error{symbol.defined_at, E_DUPLICATE_IDENTIFIER, dup->sym->defined_at};
 
 		// Last entry in the parent scope is this subscope
 		// Replace with the decl after eating up all the parameters
 		// Which should be eaten up by Parser::decl_proc_params_end
-		self->table.pop_back();
-		auto sym = push_entry<Symbol>(self);
+		auto sym = alloc<Symbol>();
 		*sym = symbol;
+		index_insert(parent->index, sym, (uint32_t)parent->table.count - 1);
+		parent->table.back() = { .sym = sym };
 
-		// move inner scope to bottom of table
-		inner_scope.idx_in_parent_table = self->table.size();
-		self->table.emplace_back(std::move(inner_scope));
-		
-		// update pointer
-		self = &std::get<Scope>(self->table.back());
+		// move inner scope to bottom of table, the scope itself stays in place
+		inner->idx_in_parent_table = parent->table.count;
+		arena_list_push(parent->table, { .scope = inner });
 		return sym;
 	}
 
@@ -99,9 +135,10 @@ namespace s22
 	{
 		auto parent = self;
 
-		auto inner = push_entry<Scope>(self);
+		auto inner = alloc<Scope>();
 		inner->parent_scope = self;
-		inner->idx_in_parent_table = self->table.size()-1;
+		inner->idx_in_parent_table = self->table.count;
+		arena_list_push(self->table, { .scope = inner });
 
 		self = inner;
 		return parent;
@@ -117,9 +154,9 @@ namespace s22
 			if (sym == nullptr)
 				continue;
 
-			if (sym->type.procedure->return_type != type)
+			if (semexpr_procedure(sym->type)->return_type != type)
 			{
-				return Error{"type mismatch"};
+				return Error{E_TYPE_MISMATCH};
 			}
 			else
 			{
@@ -127,7 +164,7 @@ namespace s22
 			}
 		}
 
-		return Error{"not within a function"};
+		return Error{E_NOT_WITHIN_FUNCTION};
 	}
 
 	Scope *
@@ -135,12 +172,12 @@ namespace s22
 	{
 		for (const auto &entry : self->table)
 		{
-			if (std::holds_alternative<Symbol>(entry))
+			if (entry.sym)
 			{
-				auto &sym = std::get<Symbol>(entry);
+				auto &sym = *entry.sym;
 
 				if (sym.is_used == false)
-					parser_log(Error{ sym.defined_at, "unused identifier" }, Log_Level::WARNING);
+					parser_log(Error{ sym.defined_at, E_UNUSED_IDENTIFIER }, Log_Level::WARNING);
 			}
 		}
 
@@ -150,22 +187,17 @@ namespace s22
 	}
 
 	Symbol *
-	scope_get_sym(Scope *self, const char *id)
+	scope_get_sym(Scope *self, Str_Id id)
 	{
-		size_t scope_idx_in_parent = self->table.size();
+		auto &stats = parser_instance()->stats;
+		stats.sym_lookups++;
+
+		// Symbols of enclosing scopes are only visible if declared before the inner scope
+		size_t scope_idx_in_parent = self->table.count;
 		for (auto scope = self; scope != nullptr; scope = scope->parent_scope)
 		{
-			for (size_t i = 0; i < scope_idx_in_parent; i++)
-			{
-				auto &entry = scope->table[i];
-				if (std::holds_alternative<Symbol>(entry))
-				{
-					auto &sym = std::get<Symbol>(entry);
-
-					if (sym.id == id)
-						return &sym;
-				}
-			}
+			if (auto slot = index_find(scope->index, id, stats.sym_probes); slot && slot->entry < scope_idx_in_parent)
+				return slot->sym;
 
 			scope_idx_in_parent = scope->idx_in_parent_table;
 		}
@@ -173,20 +205,19 @@ namespace s22
 		return nullptr;
 	}
 
-	Procedure
+	Semantic_Expr
 	scope_make_proc(Scope *self, Semantic_Expr return_type)
 	{
-		Procedure proc = { .return_type = return_type };
-
-		proc.parameters = Buf<Semantic_Expr>::make(self->table.size());
-		for (size_t i = 0; i < proc.parameters.count; i++)
+		std::vector<Semantic_Expr> parameters;
+		parameters.reserve(self->table.count);
+		for (auto &entry : self->table)
 		{
-			auto &param = std::get<Symbol>(self->table[i]);
+			auto &param = *entry.sym;
 			param.is_set = true;
-			proc.parameters[i] = param.type;
+			parameters.push_back(param.type);
 		}
 
-		return proc;
+		return semexpr_proc(Buf<Semantic_Expr>::view(parameters), return_type);
 	}
 
 	// symbol_id/sub-block, symbol_type, symbol_location, symbol flags
@@ -196,13 +227,13 @@ namespace s22
 		UI_Symbol_Table table = { .scope = self };
 		for (const auto &entry : self->table)
 		{
-			if (std::holds_alternative<Symbol>(entry))
+			if (entry.sym)
 			{
-				auto &sym = std::get<Symbol>(entry);
+				auto &sym = *entry.sym;
 				table.rows.emplace_back(UI_Symbol_Row{});
 
 				auto &symbol_row = std::get<UI_Symbol_Row>(table.rows.back());
-				symbol_row[0] = std::string{sym.id.data};
+				symbol_row[0] = std::string{str_view(sym.id)};
 				symbol_row[1] = std::format("{}", sym.type);
 				symbol_row[2] = std::format("{}", sym.defined_at);
 				symbol_row[3] = std::format("{}/{}/{}",
@@ -213,8 +244,7 @@ namespace s22
 			}
 			else
 			{
-				auto &scope = std::get<Scope>(entry);
-				table.rows.push_back(&scope);
+				table.rows.push_back((const Scope *)entry.scope);
 			}
 		}
 		return table;
@@ -5,12 +5,8 @@
 #include <imgui_internal.h>
 #include <portable-file-dialogs.h>
 
-extern FILE *yyin;
 extern int yydebug;
 
-int
-yyparse(s22::Parser *);
-
 namespace s22
 {
 	constexpr auto SOURCE_CODE_WINDOW_TITLE = "Source Code";
@@ -18,9 +14,64 @@ namespace s22
 	constexpr auto SYMBOL_TABLE_WINDOW_TITLE = "Symbol Table";
 	constexpr auto LOGS_WINDOW_TITLE = "Logs";
 
+	// Room left after the code in the editor, typing does not resize the buffer right away
+	constexpr size_t SOURCE_CODE_GROWTH = 4 * 1024;
+
 	constexpr ImGuiWindowFlags WINDOW_FLAGS = ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize;
 	constexpr ImGuiTableFlags TABLE_FLAGS = ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable;
 
+	// Make room for count bytes of code followed by the lexer padding
+	inline static void
+	source_code_reserve(UI_Source_Code &self, size_t count)
+	{
+		self.buf.resize(count + LEXER_PADDING);
+	}
+
+	// Replace the code with a loaded file, small files are copied into the editor
+	inline static void
+	source_code_load(UI_Source_Code &self, Source_Buffer file)
+	{
+		source_free(self.file);
+		self.file_lines.starts.clear();
+
+		if (file.size <= UI_SOURCE_EDIT_MAX)
+		{
+			source_code_reserve(self, file.size + SOURCE_CODE_GROWTH);
+			memcpy(self.buf.data(), file.data, file.size);
+			self.buf[file.size] = '\0';
+			self.count = file.size;
+			source_free(file);
+		}
+		else
+		{
+			self.file = file;
+			line_table_build(&self.file_lines, file.data, file.size);
+			self.buf.clear();
+			self.count = 0;
+		}
+	}
+
+	// Read only view of a large file, only the visible lines are submitted
+	inline static void
+	source_code_view(const UI_Source_Code &self)
+	{
+		if (ImGui::BeginChild("##Source_View", ImGui::GetContentRegionAvail(), true, ImGuiWindowFlags_HorizontalScrollbar))
+		{
+			auto &starts = self.file_lines.starts;
+			ImGuiListClipper clipper = {(int)starts.size()};
+			while (clipper.Step())
+			{
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+				{
+					auto begin = self.file.data + starts[i];
+					auto end = (size_t)i + 1 < starts.size() ? self.file.data + starts[i + 1] - 1 : self.file.data + self.file.size;
+					ImGui::TextUnformatted(begin, end);
+				}
+			}
+		}
+		ImGui::EndChild();
+	}
+
 	inline static void
 	source_code_window()
 	{
@@ -47,47 +98,48 @@ namespace s22
 			if (files.empty() == false)
 			{
 				strcpy_s(filepath, files[0].c_str());
-				auto f = fopen(filepath, "r");
-				s22_defer { fclose(f); };
-
-				// Get file size
-				fseek(f, 0, SEEK_END);
-				auto fsize = ftell(f);
-				rewind(f);
 
-				if (fsize + 2 > sizeof(source_code.buf))
+				if (auto [file, err] = source_load(filepath); err)
 				{
-					parser_log(Error{"file too large; max file size is 8KB"});
+					parser_log(err);
 				}
 				else
 				{
-					memset(&source_code, 0, sizeof(source_code));
-					fread(source_code.buf, fsize, 1, f);
-					source_code.count = fsize;
+					// The results of the previous code point into it
+					parser->dispose();
+					parser->ui_program.clear();
+					parser->ui_table.rows.clear();
+
+					source_code_load(source_code, file);
 				}
 			}
 		}
 
+		if (source_code.buf.empty() && source_code.file.data == nullptr)
+			source_code_reserve(source_code, SOURCE_CODE_GROWTH);
+
 		static bool debug_enabled = false;
+		static bool optimize_enabled = true;
 		if (ImGui::SameLine(); ImGui::Button("Compile"))
 		{
-			auto lexer_buf = lexer_scan_buffer(source_code.buf, source_code.count + 2);
-			if (lexer_buf == nullptr)
+			// Discard old data, run parser
+			yydebug = debug_enabled ? 1 : 0;
+			parser->unoptimized = optimize_enabled == false;
+			parser->reuse_tokens = true;
+
+			bool ok = false;
+			if (source_code.file.data != nullptr)
 			{
-				parser_log(Error{"lexer buffer is nullptr"});
-				return;
+				ok = parser_compile(parser, source_code.file.data, source_code.file.size);
 			}
-			s22_defer
+			else
 			{
-				lexer_delete_buffer(lexer_buf);
-			};
-
-			// Discard old data, run parser
-			yydebug = debug_enabled ? 1 : 0;
-			parser->dispose();
-			yyparse(parser);
+				// The editor leaves stale text past the terminator, pad the source for flex
+				memset(source_code.buf.data() + source_code.count, 0, LEXER_PADDING);
+				ok = parser_compile(parser, source_code.buf.data(), source_code.count);
+			}
 
-			if (parser->has_errors == false)
+			if (ok)
 			{
 				parser->ui_program = parser->program_write();
 				parser->ui_table = scope_get_ui_table(&parser->global);
@@ -99,13 +151,26 @@ namespace s22
 			}
 		}
 		ImGui::SameLine(); ImGui::Checkbox("Debug", &debug_enabled);
+		ImGui::SameLine(); ImGui::Checkbox("Optimize", &optimize_enabled);
+
+		if (source_code.file.data != nullptr)
+		{
+			source_code_view(source_code);
+			return;
+		}
 
 		ImGui::InputTextMultiline(
 			"##Source_Code",
-			source_code.buf, sizeof(source_code.buf),
-			ImGui::GetContentRegionAvail(), ImGuiInputTextFlags_CallbackEdit | ImGuiInputTextFlags_AllowTabInput,
+			source_code.buf.data(), source_code.buf.size() - LEXER_PADDING + 1, // keep room for the padding after the terminator
+			ImGui::GetContentRegionAvail(), ImGuiInputTextFlags_CallbackEdit | ImGuiInputTextFlags_CallbackResize | ImGuiInputTextFlags_AllowTabInput,
 			[](ImGuiInputTextCallbackData* data) -> int {
 				auto scode = (UI_Source_Code *)data->UserData;
+				if (data->EventFlag == ImGuiInputTextFlags_CallbackResize)
+				{
+					// BufSize counts the terminator, which shares the padding
+					source_code_reserve(*scode, data->BufSize - 1);
+					data->Buf = scode->buf.data();
+				}
 				scode->count = data->BufTextLen;
 				return 0;
 			},
@@ -234,7 +299,10 @@ namespace s22
 			while (clipper.Step())
 			{
 				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
-					ImGui::Text("%s", parser->ui_logs[i].c_str());
+				{
+					auto line = parser_log_line(i);
+					ImGui::TextUnformatted(line.c_str());
+				}
 			}
 
 			static size_t last_count = 0;
@@ -247,7 +315,14 @@ namespace s22
 		ImGui::EndChild();
 
 		if (ImGui::Button("Clear"))
-			parser->ui_logs.clear();
+			parser_log_clear();
+
+		// Measurements of the last compilation
+		if (parser->stats.tokens != 0)
+		{
+			ImGui::SameLine();
+			ImGui::TextDisabled("%s", std::format("{}", parser->stats).c_str());
+		}
 	}
 }
 
@@ -256,6 +331,11 @@ main(int, char**)
 {
 	using namespace s22;
 
+	// Lexes large sources in parallel
+	auto pool = pool_new();
+	s22_defer { pool_free(pool); };
+	parser_instance()->pool = pool;
+
 	s22::window_run(
 		[] { ImGui::GetStyle().CellPadding = ImVec2{4.f, 8.f}; },
 		[] {
@@ -0,0 +1,543 @@
+#include "compiler/Parser.h"
+#include "compiler/Pool.h"
+#include "compiler/CFG.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace s22
+{
+	constexpr auto SOURCE_EXTENSION = ".program";
+	constexpr auto QUADRUPLES_EXTENSION = ".quad";
+	constexpr auto SYMBOL_TABLE_EXTENSION = ".sym";
+	constexpr auto CFG_EXTENSION = ".cfg";
+
+	struct S22c_Input
+	{
+		fs::path path;
+		fs::path output;	// output path without extension
+	};
+
+	struct S22c_Options
+	{
+		std::vector<S22c_Input> inputs;
+		fs::path output_dir;	// empty to write next to the sources
+		size_t jobs;			// 0 for one per hardware thread
+		Lexer_Engine lexer;
+		bool quiet;				// do not print diagnostics
+		bool lexer_bench;		// only lex, comparing the engines
+		bool time_report;		// print the time of each phase and the counters of the compilations
+		bool unoptimized;		// write the quadruples as generated
+		bool write_cfg;			// also write the control flow graphs of each file
+	};
+
+	struct S22c_Result
+	{
+		size_t bytes;
+		size_t lines;
+		Parser_Stats stats;
+		bool failed;
+		std::string logs;	// printed by the main thread so files do not interleave
+	};
+
+	// Per worker state, reused across the files the worker compiles
+	struct S22c_Worker
+	{
+		Parser parser;
+		Program_CFG cfg;
+		std::string out;
+	};
+
+	inline static void
+	usage()
+	{
+		fprintf(stderr,
+			"usage: s22c [options] <file|directory>...\n"
+			"Compiles each file, writing its quadruples to <name>%s and its symbol table to <name>%s\n"
+			"Directories are searched recursively for %s files\n"
+			"\n"
+			"options:\n"
+			"  -o <dir>  write the outputs into dir, mirroring the directory arguments\n"
+			"  -j <n>    number of worker threads, defaults to one per hardware thread\n"
+			"  -l <name> lexer engine, flex (default) or simd\n"
+			"  -b        lex every file with both engines, check that they agree and compare their speed\n"
+			"  -g        also write the control flow graphs of each file to <name>%s\n"
+			"  -O0       do not optimize the quadruples\n"
+			"  --time-report\n"
+			"            print the time spent in each phase and what the compilations built\n"
+			"  -q        do not print diagnostics\n"
+			"  -h        show this message\n",
+			QUADRUPLES_EXTENSION, SYMBOL_TABLE_EXTENSION, SOURCE_EXTENSION, CFG_EXTENSION
+		);
+	}
+
+	inline static bool
+	options_parse(S22c_Options &self, int argc, char **argv)
+	{
+		std::vector<fs::path> args;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string_view arg = argv[i];
+			if (arg == "-h" || arg == "--help")
+			{
+				return false;
+			}
+			else if (arg == "-q")
+			{
+				self.quiet = true;
+			}
+			else if (arg == "-b")
+			{
+				self.lexer_bench = true;
+			}
+			else if (arg == "-g")
+			{
+				self.write_cfg = true;
+			}
+			else if (arg == "-O0")
+			{
+				self.unoptimized = true;
+			}
+			else if (arg == "--time-report")
+			{
+				self.time_report = true;
+			}
+			else if ((arg == "-o" || arg == "-j") && i + 1 < argc)
+			{
+				if (arg == "-o")
+					self.output_dir = argv[++i];
+				else
+					self.jobs = strtoull(argv[++i], nullptr, 10);
+			}
+			else if (arg == "-l" && i + 1 < argc)
+			{
+				std::string_view name = argv[++i];
+				if (name == "flex")
+				{
+					self.lexer = Lexer_Engine::FLEX;
+				}
+				else if (name == "simd")
+				{
+					self.lexer = Lexer_Engine::SIMD;
+				}
+				else
+				{
+					fprintf(stderr, "s22c: unknown lexer '%s'\n", argv[i]);
+					return false;
+				}
+			}
+			else if (arg.starts_with("-"))
+			{
+				fprintf(stderr, "s22c: unknown option '%s'\n", argv[i]);
+				return false;
+			}
+			else
+			{
+				args.push_back(arg);
+			}
+		}
+
+		if (args.empty())
+			return false;
+
+		for (const auto &arg : args)
+		{
+			std::error_code ec;
+			if (fs::is_directory(arg, ec))
+			{
+				// Sorted, outputs and logs should not depend on the directory order
+				std::vector<fs::path> found;
+				for (const auto &entry : fs::recursive_directory_iterator(arg, ec))
+				{
+					if (entry.is_regular_file() && entry.path().extension() == SOURCE_EXTENSION)
+						found.push_back(entry.path());
+				}
+				std::sort(found.begin(), found.end());
+
+				for (auto &path : found)
+				{
+					auto output = self.output_dir.empty() ? path : self.output_dir / fs::relative(path, arg);
+					self.inputs.push_back({ .path = path, .output = output.replace_extension() });
+				}
+			}
+			else
+			{
+				auto output = self.output_dir.empty() ? arg : self.output_dir / arg.filename();
+				self.inputs.push_back({ .path = arg, .output = output.replace_extension() });
+			}
+		}
+
+		return true;
+	}
+
+	inline static bool
+	file_write(const fs::path &path, const std::string &text)
+	{
+		auto f = fopen(path.string().c_str(), "wb");
+		if (f == nullptr)
+			return false;
+		s22_defer { fclose(f); };
+
+		return fwrite(text.data(), 1, text.size(), f) == text.size();
+	}
+
+	inline static void
+	symbols_write(std::string &out, const UI_Symbol_Table &table, size_t depth)
+	{
+		for (const auto &row : table.rows)
+		{
+			if (auto sym = std::get_if<UI_Symbol_Row>(&row))
+			{
+				std::format_to(std::back_inserter(out), "{:{}}{} | {} | {} | {}\n", "", depth * 2, (*sym)[0], (*sym)[1], (*sym)[2], (*sym)[3]);
+			}
+			else if (auto scope = std::get_if<const Scope *>(&row))
+			{
+				symbols_write(out, scope_get_ui_table(*scope), depth + 1);
+			}
+			else
+			{
+				symbols_write(out, std::get<UI_Symbol_Table>(row), depth + 1);
+			}
+		}
+	}
+
+	inline static S22c_Result
+	compile_file(const S22c_Options &options, const S22c_Input &input, S22c_Worker &worker)
+	{
+		S22c_Result res = {};
+		auto path = input.path.string();
+
+		// Mapped and scanned in place, the code is never copied
+		auto [code, err] = source_load(path.c_str());
+		if (err)
+		{
+			res.failed = true;
+			res.logs = std::format("{}: {}\n", path, err);
+			return res;
+		}
+		s22_defer { source_free(code); };
+
+		res.bytes = code.size;
+		res.lines = std::count(code.data, code.data + code.size, '\n') + (code.size != 0 && code.data[code.size - 1] != '\n');
+
+		// Bound for the whole file, formatting symbols and logs resolves against the parser
+		auto parser = &worker.parser;
+		auto prev = parser_bind(parser);
+		s22_defer
+		{
+			parser_log_clear();
+			parser_bind(prev);
+		};
+
+		res.failed = parser_compile(parser, code.data, code.size) == false;
+		res.stats = parser->stats;
+
+		if (options.quiet == false)
+		{
+			for (size_t i = 0; i < parser->ui_logs.size(); i++)
+			{
+				auto [log, line] = parser->ui_logs[i];
+				if (parser->logs[log].lvl == Log_Level::INFO)
+					continue;
+
+				auto text = parser_log_line(i);
+				if (line == 0)
+					std::format_to(std::back_inserter(res.logs), "{}: {}\n", path, text);
+				else
+					std::format_to(std::back_inserter(res.logs), "{}\n", text);
+			}
+		}
+
+		if (res.failed)
+			return res;
+
+		std::error_code ec;
+		if (auto dir = input.output.parent_path(); dir.empty() == false)
+			fs::create_directories(dir, ec);
+
+		auto quad_path = input.output;
+		quad_path += QUADRUPLES_EXTENSION;
+		worker.out.clear();
+		{
+			Phase_Timer timer = { parser->stats.emit };
+			backend_write(parser->backend, worker.out);
+		}
+		if (file_write(quad_path, worker.out) == false)
+		{
+			res.failed = true;
+			std::format_to(std::back_inserter(res.logs), "{}: cannot write file\n", quad_path.string());
+		}
+
+		auto sym_path = input.output;
+		sym_path += SYMBOL_TABLE_EXTENSION;
+		worker.out.clear();
+		{
+			Phase_Timer timer = { parser->stats.emit };
+			symbols_write(worker.out, scope_get_ui_table(&parser->global), 0);
+		}
+		if (file_write(sym_path, worker.out) == false)
+		{
+			res.failed = true;
+			std::format_to(std::back_inserter(res.logs), "{}: cannot write file\n", sym_path.string());
+		}
+
+		if (options.write_cfg)
+		{
+			auto cfg_path = input.output;
+			cfg_path += CFG_EXTENSION;
+			worker.out.clear();
+			{
+				Phase_Timer timer = { parser->stats.emit };
+				auto &program = backend_program(parser->backend);
+				cfg_build(worker.cfg, program);
+				cfg_write(worker.cfg, program, worker.out);
+			}
+			if (file_write(cfg_path, worker.out) == false)
+			{
+				res.failed = true;
+				std::format_to(std::back_inserter(res.logs), "{}: cannot write file\n", cfg_path.string());
+			}
+		}
+
+		res.stats.emit = parser->stats.emit;
+		return res;
+	}
+
+	// Index of the first token where the streams differ, the shorter count if one is a prefix of the other
+	inline static size_t
+	token_stream_mismatch(const Token_Stream &a, const Token_Stream &b)
+	{
+		auto count = std::min(a.count(), b.count());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (a.kinds[i] != b.kinds[i] || a.offsets[i] != b.offsets[i] || a.lengths[i] != b.lengths[i] || a.values[i] != b.values[i])
+				return i;
+		}
+		return count;
+	}
+
+	// Fault in the pages of a loaded file and write to them, so the first lexer to run does not pay for mapping and
+	// copying the private pages alone, flex writes to its buffer
+	inline static void
+	source_touch(char *data, size_t size)
+	{
+		auto bytes = (volatile char *)data;
+		for (size_t i = 0; i < size; i += 4096)
+			bytes[i] = bytes[i];
+		if (size != 0)
+			bytes[size - 1] = bytes[size - 1];
+	}
+
+	// Lex every input with both engines on this thread, the token streams and end locations must be equal
+	// The engines take turns running first on the files, the first one finds the code out of the cache
+	inline static bool
+	lexers_compare(const S22c_Options &options)
+	{
+		auto scanner = lexer_new();
+		if (scanner == nullptr)
+			return false;
+		s22_defer { lexer_free(scanner); };
+
+		bool ok = true;
+		size_t bytes = 0, tokens = 0;
+		std::chrono::duration<double> flex_time = {}, simd_time = {};
+		for (size_t f = 0; f < options.inputs.size(); f++)
+		{
+			auto path = options.inputs[f].path.string();
+			auto [code, err] = source_load(path.c_str());
+			if (err)
+			{
+				fputs(std::format("{}: {}\n", path, err).c_str(), stderr);
+				ok = false;
+				continue;
+			}
+			s22_defer { source_free(code); };
+			source_touch(code.data, code.size + LEXER_PADDING);
+
+			Token_Stream flex = {}, simd = {};
+			Source_Location flex_end = {}, simd_end = {};
+
+			auto run_flex = [&] {
+				auto start = std::chrono::steady_clock::now();
+				auto buf = lexer_scan_buffer(scanner, code.data, code.size + LEXER_PADDING);
+				lexer_tokenize(scanner, 0, flex, flex_end);
+				lexer_delete_buffer(scanner, buf);
+				flex_time += std::chrono::steady_clock::now() - start;
+			};
+			auto run_simd = [&] {
+				auto start = std::chrono::steady_clock::now();
+				lexer_simd_tokenize(code.data, code.size, 0, simd, simd_end);
+				simd_time += std::chrono::steady_clock::now() - start;
+			};
+
+			if (f % 2 == 0)
+			{
+				run_flex();
+				run_simd();
+			}
+			else
+			{
+				run_simd();
+				run_flex();
+			}
+
+			bytes += code.size;
+			tokens += flex.count();
+
+			auto i = token_stream_mismatch(flex, simd);
+			if (i < flex.count() || i < simd.count())
+			{
+				Line_Table lines = {};
+				line_table_build(&lines, code.data, code.size);
+
+				auto offset = i < flex.count() ? flex.offsets[i] : simd.offsets[i];
+				auto pos = line_table_find(&lines, offset);
+				fprintf(stderr, "%s:%u:%u: lexers differ at token %zu\n", path.c_str(), pos.line, pos.column, i);
+				ok = false;
+			}
+			else if (flex_end.offset != simd_end.offset || flex_end.length != simd_end.length)
+			{
+				fprintf(stderr, "%s: lexers differ at the end of input\n", path.c_str());
+				ok = false;
+			}
+		}
+
+		auto str = std::format(
+			"s22c: {} files, {:.2f} MB, {} tokens\n"
+			"s22c: flex {:.2f} MB/s, simd {:.2f} MB/s, {}\n",
+			options.inputs.size(), bytes / 1e6, tokens,
+			bytes / 1e6 / std::max(flex_time.count(), 1e-9), bytes / 1e6 / std::max(simd_time.count(), 1e-9),
+			ok ? "same tokens" : "tokens differ"
+		);
+		fputs(str.c_str(), stdout);
+		return ok;
+	}
+
+	// Per phase breakdown of the stats summed over all the compilations
+	inline static void
+	time_report(const Parser_Stats &stats)
+	{
+		auto total = std::max((stats.lex + stats.parse + stats.codegen + stats.optimize + stats.emit).count(), (int64_t)1);
+		auto phase = [&](const char *name, std::chrono::nanoseconds t) {
+			return std::format("s22c:   {:<8} {:10.3f} ms {:6.1f}%\n", name, t.count() / 1e6, t.count() * 100.0 / total);
+		};
+
+		auto str = std::string{"s22c: time report, summed over the workers\n"};
+		str += phase("lex", stats.lex);
+		str += phase("parse", stats.parse);
+		str += phase("codegen", stats.codegen);
+		str += phase("optimize", stats.optimize);
+		str += phase("emit", stats.emit);
+		std::format_to(std::back_inserter(str), "s22c:   {} tokens, {} AST nodes\n", stats.tokens, parser_stats_nodes(stats));
+		for (size_t i = 0; i < AST_KIND_COUNT; i++)
+		{
+			if (stats.nodes[i] != 0)
+				std::format_to(std::back_inserter(str), "s22c:     {:<12} {}\n", (AST::KIND)i, stats.nodes[i]);
+		}
+		std::format_to(std::back_inserter(str),
+			"s22c:   {} symbol lookups, {:.2f} probes each\n"
+			"s22c:   {:.2f} MB arena, {} quadruples, {} optimized away, {} by peephole\n",
+			stats.sym_lookups, stats.sym_lookups ? (double)stats.sym_probes / stats.sym_lookups : 0.0,
+			stats.arena_bytes / 1e6, stats.quadruples, stats.quadruples_removed, stats.peephole_removed
+		);
+		fputs(str.c_str(), stdout);
+	}
+
+	// Peak resident set size of the process in bytes
+	inline static size_t
+	peak_rss()
+	{
+	#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters = {};
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+	#else
+		rusage usage = {};
+		getrusage(RUSAGE_SELF, &usage);
+		return (size_t)usage.ru_maxrss * 1024;
+	#endif
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	using namespace s22;
+
+	S22c_Options options = {};
+	if (options_parse(options, argc, argv) == false)
+	{
+		usage();
+		return 2;
+	}
+
+	if (options.lexer_bench)
+		return lexers_compare(options) ? 0 : 1;
+
+	auto pool = pool_new(options.jobs);
+	s22_defer { pool_free(pool); };
+
+	auto worker_count = pool_worker_count(pool);
+	auto workers = std::make_unique<S22c_Worker[]>(worker_count);
+	for (size_t i = 0; i < worker_count; i++)
+	{
+		workers[i].parser.lexer = options.lexer;
+		workers[i].parser.unoptimized = options.unoptimized;
+	}
+	std::vector<S22c_Result> results(options.inputs.size());
+
+	auto start = std::chrono::steady_clock::now();
+	if (options.inputs.size() < worker_count)
+	{
+		// Too few files to keep the workers busy, compile them one by one and lex each on the pool instead
+		workers[0].parser.pool = pool;
+		for (size_t i = 0; i < options.inputs.size(); i++)
+			results[i] = compile_file(options, options.inputs[i], workers[0]);
+	}
+	else
+	{
+		pool_for(pool, options.inputs.size(), [&](size_t i, size_t worker) {
+			results[i] = compile_file(options, options.inputs[i], workers[worker]);
+		});
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	size_t bytes = 0, lines = 0, failed = 0;
+	Parser_Stats stats = {};
+	for (const auto &res : results)
+	{
+		fputs(res.logs.c_str(), stderr);
+		bytes += res.bytes;
+		lines += res.lines;
+		parser_stats_add(stats, res.stats);
+		failed += res.failed;
+	}
+
+	auto seconds = std::max(std::chrono::duration<double>(end - start).count(), 1e-9);
+	auto files = options.inputs.size();
+	auto str = std::format(
+		"s22c: {} files ({} failed), {} lines, {:.2f} MB in {:.3f}s on {} workers\n"
+		"s22c: {:.1f} files/s, {:.0f} lines/s, {:.2f} MB/s, peak RSS {:.1f} MB\n"
+		"s22c: {} tokens, lex {:.3f}s, parse {:.3f}s summed over the workers\n",
+		files, failed, lines, bytes / 1e6, seconds, worker_count,
+		files / seconds, lines / seconds, bytes / 1e6 / seconds, peak_rss() / 1e6,
+		stats.tokens, std::chrono::duration<double>(stats.lex).count(), std::chrono::duration<double>(stats.parse).count()
+	);
+	fputs(str.c_str(), stdout);
+
+	if (options.time_report)
+		time_report(stats);
+
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,595 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Generates the programs the tests and benchmarks compile, the same arguments give the same program everywhere
+namespace s22
+{
+	struct Gen
+	{
+		std::string out;
+		uint64_t state;	// splitmix64, seeded from the arguments
+		size_t names;	// count of the loop variables and procedures named so far
+	};
+
+	inline static uint64_t
+	gen_next(Gen &self)
+	{
+		uint64_t z = (self.state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	inline static size_t
+	gen_below(Gen &self, size_t n)
+	{
+		return (size_t)(gen_next(self) % n);
+	}
+
+	inline static bool
+	gen_chance(Gen &self, size_t percent)
+	{
+		return gen_below(self, 100) < percent;
+	}
+
+	inline static size_t
+	gen_range(Gen &self, size_t first, size_t last)
+	{
+		return first + gen_below(self, last - first + 1);
+	}
+
+	inline static bool
+	gen_write(const std::string &path, const std::string &str)
+	{
+		auto file = fopen(path.c_str(), "wb");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "s22gen: cannot write '%s'\n", path.c_str());
+			return false;
+		}
+
+		auto ok = fwrite(str.data(), 1, str.size(), file) == str.size();
+		return (fclose(file) == 0) && ok;
+	}
+
+	// depth blocks inside each other, each declaring decls variables from the ones of the enclosing block
+	inline static void
+	gen_nested(Gen &self, size_t depth, size_t decls)
+	{
+		self.out += "s: int = 0;\n";
+		for (size_t d = 1; d <= depth; d++)
+		{
+			self.out += "{\n";
+			for (size_t k = 0; k < decls; k++)
+			{
+				if (d == 1)
+					self.out += std::format("x{}_{}: int = s + {};\n", d, k, k);
+				else
+					self.out += std::format("x{}_{}: int = x{}_{} + {};\n", d, k, d - 1, k, k);
+			}
+		}
+
+		for (size_t k = 0; k < decls; k++)
+			self.out += std::format("s += x{}_{};\n", depth, k);
+		for (size_t d = 1; d <= depth; d++)
+			self.out += "}\n";
+	}
+
+	// count sibling blocks split evenly into groups, each declaring decls variables
+	inline static void
+	gen_blocks(Gen &self, size_t count, size_t groups, size_t decls)
+	{
+		self.out += "s: int = 0;\n";
+		for (size_t g = 0; g < groups; g++)
+		{
+			self.out += "{\n";
+			for (size_t b = g * count / groups; b < (g + 1) * count / groups; b++)
+			{
+				self.out += "\t{";
+				for (size_t k = 0; k < decls; k++)
+					self.out += std::format(" b{}: int = s + {}; s = b{};", k, b, k);
+				self.out += " }\n";
+			}
+			self.out += "}\n";
+		}
+	}
+
+	// Statements of one block, budget counts the statements left and names the declarations
+	inline static void
+	gen_mixed_block(Gen &self, size_t depth, size_t &budget)
+	{
+		auto count = 1 + gen_below(self, 4);
+		for (size_t i = 0; i < count && budget != 0; i++)
+		{
+			auto id = budget--;
+			auto k = gen_below(self, 10);
+			switch (depth < 8 ? gen_below(self, 7) : 5 + gen_below(self, 2))
+			{
+			case 0:
+				self.out += "{\n";
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\n";
+				break;
+			case 1:
+				self.out += std::format("if x > {}\n{{\n", k);
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\nelse\n{\n";
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\n";
+				break;
+			case 2:
+				self.out += std::format("while x > {}\n{{\nx -= 1;\n", k);
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\n";
+				break;
+			case 3:
+				self.out += std::format("for i{}: int = 0; i{} < {}; i{} += 1\n{{\n", id, id, k, id);
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\n";
+				break;
+			case 4:
+				self.out += "switch x\n{\ncase 0\n{\n";
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += std::format("}}\ncase 1, {}\n{{\n", k + 2);
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\ndefault\n{\n";
+				gen_mixed_block(self, depth + 1, budget);
+				self.out += "}\n}\n";
+				break;
+			case 5:
+				self.out += std::format("x = f(x) + {};\n", k);
+				break;
+			default:
+				self.out += std::format("v{}: int = x + {};\nx = v{};\n", id, k, id);
+				break;
+			}
+		}
+	}
+
+	// Blocks, branches, loops and switches nested up to 8 deep around calls and declarations, about count statements
+	inline static void
+	gen_mixed(Gen &self, size_t count)
+	{
+		self.out += "x: int = 0;\nf :: proc(a: int) -> int\n{\nreturn a + 1;\n}\n";
+		while (count != 0)
+			gen_mixed_block(self, 0, count);
+	}
+
+	// Random programs over a few variables of each type: 'i' int, 'u' uint and 'f' float
+	// Arguments of one std::format are unsequenced, random parts are drawn into locals first
+	inline static std::string
+	gen_program_literal(Gen &self, char type)
+	{
+		auto a = gen_below(self, 10);
+		if (type == 'i')
+			return std::format("{}", a);
+		if (type == 'u')
+			return std::format("{}u", a);
+		auto b = gen_below(self, 10);
+		return std::format("{}.{}", a, b);
+	}
+
+	inline static std::string
+	gen_program_var(Gen &self, char type)
+	{
+		std::string_view vars = type == 'i' ? "abcde" : type == 'u' ? "gh" : "xy";
+		return std::string(1, vars[gen_below(self, vars.size())]);
+	}
+
+	inline static std::string
+	gen_program_expr(Gen &self, char type, size_t depth = 0)
+	{
+		static const char *FLOAT_OPS[] = { "+", "-", "*" };
+		static const char *INT_OPS[] = { "+", "-", "*", "&", "|", "^", "/", "%", "<<", ">>" };
+
+		auto r = gen_below(self, 100);
+		if (depth > 2 || r < 25)
+			return gen_program_literal(self, type);
+		if (r < 50)
+		{
+			if (type != 'i' || gen_chance(self, 80))
+				return gen_program_var(self, type);
+			return std::format("arr[{}]", gen_below(self, 4));
+		}
+
+		std::string_view op = type == 'f' ? FLOAT_OPS[gen_below(self, std::size(FLOAT_OPS))] : INT_OPS[gen_below(self, std::size(INT_OPS))];
+		auto suffix = type == 'u' ? "u" : "";
+		if (op == "/" || op == "%" || op == "<<" || op == ">>")
+		{
+			auto left = gen_program_expr(self, type, depth + 1);
+			auto right = op[0] == '/' || op[0] == '%' ? gen_range(self, 1, 7) : gen_range(self, 0, 5);
+			return std::format("({}) {} {}{}", left, op, right, suffix);
+		}
+		if (r < 60 && type != 'u')
+			return std::format("-({})", gen_program_expr(self, type, depth + 1));
+
+		auto left = gen_program_expr(self, type, depth + 1);
+		auto right = gen_program_expr(self, type, depth + 1);
+		return std::format("({}) {} ({})", left, op, right);
+	}
+
+	inline static std::string
+	gen_program_cond(Gen &self, size_t depth = 0)
+	{
+		static const char *BOOLS[] = { "f", "true", "false" };
+		static const char *COMPARES[] = { "<", ">", "==", "!=", "<=", ">=" };
+
+		auto r = gen_below(self, 100);
+		if (depth < 2 && r < 15)
+			return std::format("!({})", gen_program_cond(self, depth + 1));
+		if (depth < 2 && r < 45)
+		{
+			auto left = gen_program_cond(self, depth + 1);
+			auto right = gen_program_cond(self, depth + 1);
+			return std::format("({}) {} ({})", left, r < 30 ? "&&" : "||", right);
+		}
+		if (r < 55)
+			return BOOLS[gen_below(self, std::size(BOOLS))];
+
+		auto type = "iiuf"[gen_below(self, 4)];
+		auto left = gen_program_expr(self, type, 1);
+		auto compare = COMPARES[gen_below(self, std::size(COMPARES))];
+		auto right = gen_program_expr(self, type, 2);
+		return std::format("({}) {} ({})", left, compare, right);
+	}
+
+	inline static void
+	gen_program_line(Gen &self, size_t indent, std::string_view line)
+	{
+		self.out.append(indent, '\t');
+		self.out += line;
+		self.out += '\n';
+	}
+
+	inline static void gen_program_stmt(Gen &self, size_t indent, size_t depth, bool in_proc);
+
+	inline static void
+	gen_program_stmts(Gen &self, size_t indent, size_t depth, bool in_proc)
+	{
+		for (size_t i = gen_range(self, 1, 3); i != 0; i--)
+			gen_program_stmt(self, indent, depth, in_proc);
+	}
+
+	// Assignments, branches, loops, switches, returns, procedures and blocks, nested at most 4 deep
+	inline static void
+	gen_program_stmt(Gen &self, size_t indent, size_t depth, bool in_proc)
+	{
+		static const char *ASSIGNS[] = { "=", "=", "+=", "-=" };
+		static const char *INDICES[] = { "0", "1", "2", "2" };
+
+		auto r = gen_below(self, 100);
+		if (depth > 3 || r < 35)
+		{
+			auto type = "iiuf"[gen_below(self, 4)];
+			auto var = type != 'i' || gen_chance(self, 85) ? gen_program_var(self, type) : std::format("arr[{}]", INDICES[gen_below(self, 4)]);
+			auto assign = ASSIGNS[gen_below(self, std::size(ASSIGNS))];
+			gen_program_line(self, indent, std::format("{} {} {};", var, assign, gen_program_expr(self, type)));
+		}
+		else if (r < 45)
+		{
+			gen_program_line(self, indent, std::format("f = {};", gen_program_cond(self)));
+		}
+		else if (r < 57)
+		{
+			gen_program_line(self, indent, std::format("if {} {{", gen_program_cond(self)));
+			gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+			while (gen_chance(self, 40))
+			{
+				gen_program_line(self, indent, std::format("}} else if {} {{", gen_program_cond(self)));
+				gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+			}
+			if (gen_chance(self, 50))
+			{
+				gen_program_line(self, indent, "} else {");
+				gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+			}
+			gen_program_line(self, indent, "}");
+		}
+		else if (r < 71)
+		{
+			auto w = std::format("w{}", self.names++);
+			gen_program_line(self, indent, std::format("{}: int = 0;", w));
+			auto count = gen_range(self, 0, 4);
+			if (r < 65)
+			{
+				gen_program_line(self, indent, std::format("while {} < {} && ({}) {{", w, count, gen_program_cond(self)));
+				gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+				gen_program_line(self, indent + 1, std::format("{} += 1;", w));
+				gen_program_line(self, indent, "}");
+			}
+			else
+			{
+				gen_program_line(self, indent, "do {");
+				gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+				gen_program_line(self, indent + 1, std::format("{} += 1;", w));
+				gen_program_line(self, indent, std::format("}} while {} < {};", w, count));
+			}
+		}
+		else if (r < 78)
+		{
+			auto i = std::format("i{}", self.names++);
+			gen_program_line(self, indent, std::format("for {}: int = 0; {} < {}; {} += 1 {{", i, i, gen_range(self, 0, 4), i));
+			gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+			gen_program_line(self, indent, "}");
+		}
+		else if (r < 84)
+		{
+			auto k = gen_below(self, 3);
+			gen_program_line(self, indent, std::format("switch {} {{", k == 0 ? "a" : k == 1 ? "b" : std::format("{}", gen_range(self, 0, 6))));
+			for (size_t c = 0, cases = gen_range(self, 1, 3); c < cases; c++)
+			{
+				gen_program_line(self, indent + 1, std::format("case {}, {} {{", 3 * c, 3 * c + 1));
+				gen_program_stmts(self, indent + 2, depth + 1, in_proc);
+				gen_program_line(self, indent + 1, "}");
+			}
+			if (gen_chance(self, 50))
+			{
+				gen_program_line(self, indent + 1, "default {");
+				gen_program_stmts(self, indent + 2, depth + 1, in_proc);
+				gen_program_line(self, indent + 1, "}");
+			}
+			gen_program_line(self, indent, "}");
+		}
+		else if (r < 88 && in_proc)
+		{
+			auto cond = gen_program_cond(self);
+			gen_program_line(self, indent, std::format("if {} {{ return {}; }}", cond, gen_program_expr(self, 'i')));
+		}
+		else if (r < 93 && depth < 2 && in_proc == false)
+		{
+			auto name = std::format("p{}", self.names++);
+			gen_program_line(self, indent, std::format("{} :: proc(q: int) -> int {{", name));
+			gen_program_line(self, indent + 1, std::format("k: int = {};", gen_program_literal(self, 'i')));
+			gen_program_line(self, indent + 1, "l: int = q + k * 2;");
+			gen_program_stmts(self, indent + 1, depth + 1, true);
+			gen_program_line(self, indent + 1, "return l + k;");
+			gen_program_line(self, indent, "}");
+			auto var = gen_program_var(self, 'i');
+			gen_program_line(self, indent, std::format("{} = {}({});", var, name, gen_program_expr(self, 'i')));
+		}
+		else
+		{
+			gen_program_line(self, indent, "{");
+			gen_program_stmts(self, indent + 1, depth + 1, in_proc);
+			gen_program_line(self, indent, "}");
+		}
+	}
+
+	// The variables, then count statements at the top level
+	inline static void
+	gen_program(Gen &self, size_t count)
+	{
+		self.out += "arr: [4]int;\n";
+		for (auto v : std::string_view{"abcde"})
+		{
+			auto a = gen_range(self, 0, 5);
+			if (gen_chance(self, 50))
+				self.out += std::format("{}: int = {};\n", v, a);
+			else
+				self.out += std::format("{}: int = arr[{}] + {};\n", v, a % 4, gen_range(self, 0, 5));
+		}
+		for (auto v : std::string_view{"gh"})
+			self.out += std::format("{}: uint = {}u;\n", v, gen_range(self, 0, 5));
+		for (auto v : std::string_view{"xy"})
+			self.out += std::format("{}: float = {}.5;\n", v, gen_range(self, 0, 5));
+		self.out += "f: bool = false;\n";
+
+		for (size_t i = 0; i < count; i++)
+			gen_program_stmt(self, 0, 0, false);
+	}
+
+	// files random programs of count statements, the seeds follow each other from seed
+	inline static bool
+	gen_programs(const std::string &dir, size_t files, size_t count, uint64_t seed)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+
+		for (size_t i = 0; i < files; i++)
+		{
+			Gen gen = {};
+			gen.state = seed + i;
+			gen_program(gen, count);
+			if (gen_write(std::format("{}/program_{}.program", dir, i), gen.out) == false)
+				return false;
+		}
+		return true;
+	}
+
+	// Random digits, the first one is not 0
+	inline static void
+	gen_digits(Gen &self, size_t count)
+	{
+		self.out += (char)('1' + gen_below(self, 9));
+		for (size_t i = 1; i < count; i++)
+			self.out += (char)('0' + gen_below(self, 10));
+	}
+
+	// count literals of every type and length that fits it, summed into one variable per type
+	inline static void
+	gen_literals(Gen &self, size_t count)
+	{
+		self.out += "si: int = 0;\nsu: uint = 0u;\nsf: float = 0.0;\n";
+		for (size_t i = 0; i < count; i++)
+		{
+			switch (gen_below(self, 3))
+			{
+			case 0:
+				self.out += "si += ";
+				gen_digits(self, 1 + gen_below(self, 18));
+				break;
+			case 1:
+				self.out += "su += ";
+				gen_digits(self, 1 + gen_below(self, 19));
+				self.out += 'u';
+				break;
+			default:
+				self.out += "sf += ";
+				gen_digits(self, 1 + gen_below(self, 15));
+				self.out += '.';
+				gen_digits(self, 1 + gen_below(self, 15));
+				break;
+			}
+			self.out += ";\n";
+		}
+	}
+
+	// Every keyword, operator, literal form and comment, with the near misses and bytes that are no token
+	inline static std::vector<std::string>
+	gen_lexer_fragments()
+	{
+		using namespace std::literals;
+		std::vector<std::string> frags = {
+			// Keywords and identifiers that start like them
+			"const", "if", "else", "while", "do", "for", "switch", "case", "default", "proc", "return",
+			"true", "false", "int", "uint", "float", "bool",
+			"iff", "int8", "_x", "truex", "x_1", "A", "Z_", "__",
+			"averyveryverylongidentifiername_with_digits_0123456789_and_more",
+
+			// Literals, the largest of each type and the first that overflows
+			"0", "12", "007", "1.5", "1.", "1.u", ".5", "3u", "3uu", "12.34.56", "1.5e3", "0x1f",
+			"99999999999", "2147483648", "4294967297u", "123456789012345678901234567890",
+			"9223372036854775807", "9223372036854775808", "18446744073709551615u", "18446744073709551616u",
+			std::string(308, '9') + ".0", std::string(309, '9') + ".0",
+			"0." + std::string(400, '0') + "1", "0." + std::string(322, '0') + "5",
+
+			// Operators, with the longer sequences made of them
+			"+", "-", "*", "/", "%", "&", "|", "=", "^", "!", "~", "<", ">",
+			"+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>=",
+			"<<", ">>", "<=", "==", "!=", ">=", "&&", "||", "::", "->",
+			":", ";", "{", "}", ",", "(", ")", "[", "]",
+			"&&=", "<<<", ">>>=", "-->", "///",
+
+			// Comments and whitespace
+			"//", "// comment", "// x\r", "\t", "  ", "\t \t", std::string(40, ' '),
+			"\n", "\n", "\n", "\r\n", "\r",
+
+			// Bytes that start no token
+			"$", "@", "#", ".", "?", "\"", "'", "\\", "\0"s, "\x80", "\xff", "\xc3\xa9", "`",
+		};
+		return frags;
+	}
+
+	// files random sequences of fragments cut at a random byte, so the input can end inside any token
+	// Then each fragment alone, ending at the end of input
+	inline static bool
+	gen_lexer(Gen &self, const std::string &dir, size_t files, size_t fragments)
+	{
+		static const char *SEPARATORS[] = { "", " ", "\n", "\t" };
+
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+
+		auto frags = gen_lexer_fragments();
+		for (size_t i = 0; i < files; i++)
+		{
+			self.out.clear();
+			for (size_t j = 0; j < fragments; j++)
+			{
+				self.out += frags[gen_below(self, frags.size())];
+				if (gen_below(self, 2) == 0)
+					self.out += SEPARATORS[gen_below(self, std::size(SEPARATORS))];
+			}
+
+			if (self.out.empty() == false)
+				self.out.resize(self.out.size() - gen_below(self, std::min<size_t>(self.out.size(), 64)));
+			if (gen_write(std::format("{}/lex_{}.program", dir, i), self.out) == false)
+				return false;
+		}
+
+		for (size_t i = 0; i < frags.size(); i++)
+		{
+			if (gen_write(std::format("{}/edge_{}.program", dir, i), frags[i]) == false)
+				return false;
+		}
+		return true;
+	}
+
+	inline static void
+	usage()
+	{
+		fprintf(stderr,
+			"usage: s22gen <kind> [args]... [-o <file>]\n"
+			"Writes a generated program to stdout or to file, the lexer and program corpora to the directory given with -o\n"
+			"\n"
+			"kinds:\n"
+			"  nested <depth> [decls]             blocks nested depth deep, decls declarations in each (1)\n"
+			"  blocks <count> <groups> [decls]    count sibling blocks in groups, decls declarations in each (1)\n"
+			"  program <count> [seed]             count random statements of every kind over a few variables\n"
+			"  programs <files> <count> [seed]    files random programs of count statements, -o is required\n"
+			"  mixed <count> [seed]               about count statements in nested blocks, branches, loops and switches\n"
+			"  literals <count> [seed]            count int, uint and float literals of random lengths\n"
+			"  lexer <files> <fragments> [seed]   random fragment files and one file per fragment, -o is required\n"
+		);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	using namespace s22;
+
+	const char *path = nullptr;
+	std::string_view kind;
+	size_t args[4] = {};
+	size_t arg_count = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+			path = argv[++i];
+		else if (kind.empty())
+			kind = arg;
+		else if (arg_count < std::size(args))
+			args[arg_count++] = strtoull(argv[i], nullptr, 10);
+	}
+
+	Gen gen = {};
+	if (kind == "nested" && arg_count >= 1)
+	{
+		gen_nested(gen, args[0], arg_count >= 2 ? args[1] : 1);
+	}
+	else if (kind == "blocks" && arg_count >= 2 && args[1] != 0)
+	{
+		gen_blocks(gen, args[0], args[1], arg_count >= 3 ? args[2] : 1);
+	}
+	else if (kind == "program" && arg_count >= 1)
+	{
+		gen.state = arg_count >= 2 ? args[1] : 0;
+		gen_program(gen, args[0]);
+	}
+	else if (kind == "programs" && arg_count >= 2 && path != nullptr)
+	{
+		return gen_programs(path, args[0], args[1], arg_count >= 3 ? args[2] : 0) ? 0 : 1;
+	}
+	else if (kind == "mixed" && arg_count >= 1)
+	{
+		gen.state = arg_count >= 2 ? args[1] : 0;
+		gen_mixed(gen, args[0]);
+	}
+	else if (kind == "literals" && arg_count >= 1)
+	{
+		gen.state = arg_count >= 2 ? args[1] : 0;
+		gen_literals(gen, args[0]);
+	}
+	else if (kind == "lexer" && arg_count >= 2 && path != nullptr)
+	{
+		gen.state = arg_count >= 3 ? args[2] : 0;
+		return gen_lexer(gen, path, args[0], args[1]) ? 0 : 1;
+	}
+	else
+	{
+		usage();
+		return 2;
+	}
+
+	if (path != nullptr)
+		return gen_write(path, gen.out) ? 0 : 1;
+	return fwrite(gen.out.data(), 1, gen.out.size(), stdout) == gen.out.size() ? 0 : 1;
+}
@@ -0,0 +1,463 @@
+#include "compiler/Parser.h"
+#include "compiler/CFG.h"
+
+#include <bit>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+// Runs the quadruples of programs compiled with and without optimization, both must leave the same variables
+namespace s22
+{
+	constexpr size_t RUN_STEPS_MAX = 2'000'000;
+
+	enum RUN_STATUS
+	{
+		RUN_DONE,
+		RUN_TRAP,		// division by 0, shift by 64 or more, unknown instruction
+		RUN_BOOL,		// logical operand that is not 0 or 1
+		RUN_LIMIT,		// too many steps, the program may not stop
+	};
+
+	// Memory cells are named by kind, identifier and index like the quadruples name them, shadowed variables share theirs
+	enum RUN_CELL : uint64_t
+	{
+		RUN_CELL_SYM = 1,
+		RUN_CELL_ELEM,
+		RUN_CELL_PARAM,
+		RUN_CELL_RET,
+	};
+
+	struct Run_Frame
+	{
+		uint32_t ret;	// instruction after the call
+		std::unordered_map<uint64_t, uint64_t> tmps;
+	};
+
+	struct Run
+	{
+		const Program *program;
+		Program_CFG cfg;
+		std::vector<uint32_t> proc_end;	// instruction after the end of the procedure labeled at each PROC
+		std::unordered_map<uint64_t, uint64_t> memory;
+		std::vector<Run_Frame> frames;
+		RUN_STATUS status;
+		size_t steps;
+	};
+
+	inline static uint64_t
+	run_cell(RUN_CELL kind, uint64_t sym, uint64_t index = 0)
+	{
+		return kind << 60 | sym << 28 | (index & 0xFFFFFFF);
+	}
+
+	inline static uint64_t
+	run_load(Run &self, uint64_t cell)
+	{
+		auto it = self.memory.find(cell);
+		return it == self.memory.end() ? 0 : it->second;
+	}
+
+	inline static uint64_t
+	run_tmp(Run &self, uint64_t tmp)
+	{
+		auto &tmps = self.frames.back().tmps;
+		auto it = tmps.find(tmp);
+		return it == tmps.end() ? 0 : it->second;
+	}
+
+	inline static uint64_t
+	run_address(Run &self, const Operand &opr)
+	{
+		switch (opr.loc)
+		{
+		case OP_SYM: return run_cell(RUN_CELL_SYM, opr.sym.idx);
+		case OP_PARAM: return run_cell(RUN_CELL_PARAM, opr.sym.idx, opr.value);
+		case OP_RET: return run_cell(RUN_CELL_RET, opr.sym.idx);
+		case OP_ELEM: {
+			uint64_t index = opr.value;
+			if (opr.index_loc == OP_TMP)
+				index = run_tmp(self, opr.value);
+			else if (opr.index_loc == OP_SYM)
+				index = run_load(self, run_cell(RUN_CELL_SYM, opr.value));
+			return run_cell(RUN_CELL_ELEM, opr.sym.idx, index);
+		}
+		default: return 0;
+		}
+	}
+
+	inline static uint64_t
+	run_get(Run &self, const Operand &opr)
+	{
+		switch (opr.loc)
+		{
+		case OP_IMM: return opr.value;
+		case OP_TMP: return run_tmp(self, opr.value);
+		default: return run_load(self, run_address(self, opr));
+		}
+	}
+
+	inline static void
+	run_set(Run &self, const Operand &opr, uint64_t value)
+	{
+		if (opr.loc == OP_TMP)
+			self.frames.back().tmps[opr.value] = value;
+		else
+			self.memory[run_address(self, opr)] = value;
+	}
+
+	// Compare of typed operands, compare-and-branch and compare-and-set share the order of their relations
+	inline static bool
+	run_compare(INSTRUCTION_OP op, Semantic_Expr::BASE type, uint64_t a, uint64_t b)
+	{
+		auto relation = [op](auto x, auto y) {
+			switch (op)
+			{
+			case I_LOG_LT: case I_SLT: return x < y;
+			case I_LOG_LEQ: case I_SLE: return x <= y;
+			case I_LOG_EQ: case I_SEQ: return x == y;
+			case I_LOG_NEQ: case I_SNE: return x != y;
+			case I_LOG_GT: case I_SGT: return x > y;
+			default: return x >= y;
+			}
+		};
+
+		if (type == Semantic_Expr::FLOAT)
+			return relation(std::bit_cast<double>(a), std::bit_cast<double>(b));
+		if (type == Semantic_Expr::UINT || type == Semantic_Expr::BOOL)
+			return relation(a, b);
+		return relation((int64_t)a, (int64_t)b);
+	}
+
+	// Arithmetic of typed operands, false when it traps
+	inline static bool
+	run_arithmetic(INSTRUCTION_OP op, Semantic_Expr::BASE type, uint64_t a, uint64_t b, uint64_t &res)
+	{
+		if (type == Semantic_Expr::FLOAT)
+		{
+			auto x = std::bit_cast<double>(a), y = std::bit_cast<double>(b);
+			switch (op)
+			{
+			case I_ADD: res = std::bit_cast<uint64_t>(x + y); return true;
+			case I_SUB: res = std::bit_cast<uint64_t>(x - y); return true;
+			case I_MUL: res = std::bit_cast<uint64_t>(x * y); return true;
+			case I_DIV: res = std::bit_cast<uint64_t>(x / y); return y != 0;
+			default: return false;
+			}
+		}
+
+		bool is_signed = type != Semantic_Expr::UINT && type != Semantic_Expr::BOOL;
+		switch (op)
+		{
+		case I_ADD: res = a + b; return true;
+		case I_SUB: res = a - b; return true;
+		case I_MUL: res = a * b; return true;
+		case I_AND: res = a & b; return true;
+		case I_OR: res = a | b; return true;
+		case I_XOR: res = a ^ b; return true;
+		case I_DIV: case I_MOD:
+			if (b == 0 || (is_signed && (int64_t)a == INT64_MIN && (int64_t)b == -1))
+				return false;
+			if (is_signed)
+				res = op == I_DIV ? (uint64_t)((int64_t)a / (int64_t)b) : (uint64_t)((int64_t)a % (int64_t)b);
+			else
+				res = op == I_DIV ? a / b : a % b;
+			return true;
+		case I_SHL: case I_SHR:
+			if (b >= 64)
+				return false;
+			if (op == I_SHL)
+				res = a << b;
+			else
+				res = is_signed ? (uint64_t)((int64_t)a >> b) : a >> b;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Returns to the caller, the program is done when it returns from the code outside procedures
+	inline static uint32_t
+	run_return(Run &self)
+	{
+		if (self.frames.size() == 1)
+			return (uint32_t)self.program->count();
+
+		auto ret = self.frames.back().ret;
+		self.frames.pop_back();
+		return ret;
+	}
+
+	inline static void
+	run_program(Run &self, const Program &program)
+	{
+		self.program = &program;
+		self.memory.clear();
+		self.frames.assign(1, {});
+		self.status = RUN_DONE;
+		self.steps = 0;
+		cfg_build(self.cfg, program);
+
+		// Control flows past procedure declarations
+		auto count = (uint32_t)program.count();
+		self.proc_end.assign(count, 0);
+		std::vector<uint32_t> procs;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (program.labels[i].type == Label::PROC)
+				procs.push_back(i);
+			if (program.labels[i].type == Label::END_PROC && procs.empty() == false)
+			{
+				self.proc_end[procs.back()] = i + 1;
+				procs.pop_back();
+			}
+		}
+
+		uint32_t pc = 0;
+		while (pc < count)
+		{
+			if (++self.steps > RUN_STEPS_MAX)
+			{
+				self.status = RUN_LIMIT;
+				return;
+			}
+
+			auto op = program.ops[pc].op;
+			auto type = (Semantic_Expr::BASE)program.ops[pc].type;
+			auto &dst = program.operands[3 * pc];
+			auto &src1 = program.operands[3 * pc + 1];
+			auto &src2 = program.operands[3 * pc + 2];
+
+			bool taken = false;
+			uint32_t next = pc + 1;
+			switch (op)
+			{
+			case I_NOP:
+				break;
+
+			case I_MOV:
+				run_set(self, dst, run_get(self, src1));
+				break;
+
+			case I_ADD: case I_SUB: case I_MUL: case I_DIV: case I_MOD:
+			case I_AND: case I_OR: case I_XOR: case I_SHL: case I_SHR: {
+				uint64_t res = 0;
+				if (run_arithmetic(op, type, run_get(self, src1), run_get(self, src2), res) == false)
+				{
+					self.status = RUN_TRAP;
+					return;
+				}
+				run_set(self, dst, res);
+				break;
+			}
+
+			case I_NEG: {
+				auto a = run_get(self, src1);
+				run_set(self, dst, type == Semantic_Expr::FLOAT ? a ^ (1ull << 63) : 0 - a);
+				break;
+			}
+
+			case I_INV:
+				run_set(self, dst, ~run_get(self, src1));
+				break;
+
+			case I_BR:
+				taken = true;
+				break;
+
+			case I_BZ: case I_BNZ: {
+				auto a = run_get(self, src1);
+				bool zero = a == 0 || (type == Semantic_Expr::FLOAT && a == (1ull << 63));
+				taken = zero == (op == I_BZ);
+				break;
+			}
+
+			case I_LOG_LT: case I_LOG_LEQ: case I_LOG_EQ: case I_LOG_NEQ: case I_LOG_GT: case I_LOG_GEQ:
+				taken = run_compare(op, type, run_get(self, src1), run_get(self, src2));
+				break;
+
+			case I_SLT: case I_SLE: case I_SEQ: case I_SNE: case I_SGT: case I_SGE:
+				run_set(self, dst, run_compare(op, type, run_get(self, src1), run_get(self, src2)));
+				break;
+
+			case I_LAND: case I_LOR: {
+				auto a = run_get(self, src1), b = run_get(self, src2);
+				if (a > 1 || b > 1)
+				{
+					self.status = RUN_BOOL;
+					return;
+				}
+				run_set(self, dst, op == I_LAND ? a & b : a | b);
+				break;
+			}
+
+			case I_CALL: {
+				auto target = self.cfg.targets[pc];
+				if (target == CFG_NONE)
+					break;
+				self.frames.push_back({ pc + 1, {} });
+				pc = target;
+				continue;
+			}
+
+			case I_RET:
+				pc = run_return(self);
+				continue;
+
+			default:
+				self.status = RUN_TRAP;
+				return;
+			}
+
+			// Branches to the end of a procedure return from it, procedures may share a name
+			if (taken)
+			{
+				if (dst.label.type == Label::END_PROC)
+				{
+					pc = run_return(self);
+					continue;
+				}
+				next = self.cfg.targets[pc] == CFG_NONE ? count : self.cfg.targets[pc];
+			}
+
+			while (next < count && program.labels[next].type == Label::PROC && self.proc_end[next] != 0)
+				next = self.proc_end[next];
+			pc = next;
+		}
+	}
+
+	// Variables and array elements left by the run, cells never written or left 0 read the same
+	inline static std::map<uint64_t, uint64_t>
+	run_variables(const Run &self)
+	{
+		std::map<uint64_t, uint64_t> res;
+		for (auto [cell, value] : self.memory)
+		{
+			auto kind = cell >> 60;
+			if ((kind == RUN_CELL_SYM || kind == RUN_CELL_ELEM) && value != 0)
+				res.emplace(cell, value);
+		}
+		return res;
+	}
+
+	inline static void
+	usage()
+	{
+		fprintf(stderr,
+			"usage: s22run <file|directory>...\n"
+			"Compiles each program with and without optimization and runs both quadruple programs\n"
+			"They must stop the same way and leave the same values in the variables\n"
+			"Directories are searched recursively for .program files, variables must not shadow each other\n"
+		);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	using namespace s22;
+
+	std::vector<fs::path> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::error_code ec;
+		if (fs::is_directory(argv[i], ec))
+		{
+			for (const auto &entry : fs::recursive_directory_iterator(argv[i], ec))
+			{
+				if (entry.is_regular_file() && entry.path().extension() == ".program")
+					inputs.push_back(entry.path());
+			}
+		}
+		else
+		{
+			inputs.push_back(argv[i]);
+		}
+	}
+	std::sort(inputs.begin(), inputs.end());
+
+	if (inputs.empty())
+	{
+		usage();
+		return 2;
+	}
+
+	size_t same = 0, differ = 0, failed = 0, endless = 0, quadruples = 0, removed = 0;
+	Run runs[2] = {};
+	for (const auto &input : inputs)
+	{
+		auto path = input.string();
+		auto [code, err] = source_load(path.c_str());
+		if (err)
+		{
+			fputs(std::format("{}: {}\n", path, err).c_str(), stderr);
+			failed++;
+			continue;
+		}
+		s22_defer { source_free(code); };
+
+		// Each compilation scans the code in place, unoptimized then optimized
+		bool compiled = true;
+		for (size_t o = 0; o < 2; o++)
+		{
+			Parser parser = {};
+			parser.unoptimized = o == 0;
+			auto prev = parser_bind(&parser);
+			s22_defer
+			{
+				parser_log_clear();
+				parser_bind(prev);
+			};
+
+			if (parser_compile(&parser, code.data, code.size) == false)
+			{
+				compiled = false;
+				break;
+			}
+
+			auto &program = backend_program(parser.backend);
+			quadruples += o == 0 ? program.count() : 0;
+			removed += parser.stats.quadruples_removed;
+			run_program(runs[o], program);
+		}
+
+		if (compiled == false)
+		{
+			fprintf(stderr, "%s: does not compile\n", path.c_str());
+			failed++;
+			continue;
+		}
+
+		if (runs[0].status == RUN_LIMIT || runs[1].status == RUN_LIMIT)
+		{
+			endless++;
+			continue;
+		}
+
+		if (runs[0].status == RUN_BOOL || runs[1].status == RUN_BOOL)
+		{
+			fprintf(stderr, "%s: logical operand that is not a boolean\n", path.c_str());
+			differ++;
+		}
+		else if (runs[0].status != runs[1].status || run_variables(runs[0]) != run_variables(runs[1]))
+		{
+			fprintf(stderr, "%s: optimized program ends differently, in %zu steps instead of %zu\n", path.c_str(), runs[1].steps, runs[0].steps);
+			differ++;
+		}
+		else
+		{
+			same++;
+		}
+	}
+
+	auto str = std::format(
+		"s22run: {} programs, {} same, {} differ, {} failed, {} stopped after {} steps\n"
+		"s22run: {} quadruples, {} optimized away\n",
+		inputs.size(), same, differ, failed, endless, RUN_STEPS_MAX,
+		quadruples, removed
+	);
+	fputs(str.c_str(), stdout);
+	return differ == 0 && failed == 0 ? 0 : 1;
+}
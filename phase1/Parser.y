@@ -8,6 +8,8 @@
 // Required for token type definition
 %code requires {
 	#include <stdint.h>
+	#include <string.h>		// strlen, memcpy
+	#include <algorithm>	// std::min
 	struct Literal
 	{
 		union
@@ -38,8 +40,9 @@
 			*this = {};
 			if (str != nullptr)
 			{
-				strcpy_s(this->data, str);
-				this->count = strlen(str);
+				// Longer strings are truncated, data stays null terminated
+				this->count = std::min(strlen(str), (size_t)CAP);
+				memcpy(this->data, str, this->count);
 			}
 		}
 
@@ -0,0 +1,40 @@
+# Compiles a golden program and compares the outputs with the expected files next to it
+# cmake -DS22C=<s22c> -DDIR=<golden dir> -DPROGRAM=<name> -DEXPECTED=<name> -DOUT=<dir> [-DOPTIONS=<options>] -P golden.cmake
+# Each of <expected>.quad, .sym and .cfg that exists must equal the output, <expected>.err the diagnostics
+file(REMOVE_RECURSE ${OUT})
+separate_arguments(OPTIONS)
+
+# Relative to DIR, diagnostics name the program the same on every machine
+execute_process(
+	COMMAND ${S22C} ${OPTIONS} -o ${OUT} ${PROGRAM}.program
+	WORKING_DIRECTORY ${DIR}
+	ERROR_VARIABLE logs
+	OUTPUT_QUIET
+)
+
+set(compared 0)
+foreach(ext quad sym cfg)
+	if (EXISTS ${DIR}/${EXPECTED}.${ext})
+		execute_process(
+			COMMAND ${CMAKE_COMMAND} -E compare_files ${OUT}/${PROGRAM}.${ext} ${DIR}/${EXPECTED}.${ext}
+			RESULT_VARIABLE differ
+		)
+		if (differ)
+			message(FATAL_ERROR "${OUT}/${PROGRAM}.${ext} differs from ${DIR}/${EXPECTED}.${ext}")
+		endif()
+		math(EXPR compared "${compared} + 1")
+	endif()
+endforeach()
+
+if (EXISTS ${DIR}/${EXPECTED}.err)
+	file(READ ${DIR}/${EXPECTED}.err expected_logs)
+	if (NOT logs STREQUAL expected_logs)
+		file(WRITE ${OUT}/${PROGRAM}.err "${logs}")
+		message(FATAL_ERROR "${OUT}/${PROGRAM}.err differs from ${DIR}/${EXPECTED}.err")
+	endif()
+	math(EXPR compared "${compared} + 1")
+endif()
+
+if (compared EQUAL 0)
+	message(FATAL_ERROR "no expected output for ${EXPECTED} in ${DIR}")
+endif()